@@ -37,6 +37,16 @@
 	#define ISLA_MAX_NEIGHBORS 16
 #endif
 
+#ifndef ISLA_CANCEL_PERIOD
+	#define ISLA_CANCEL_PERIOD 64
+#endif
+
+#ifndef ISLA_GRID_COST_STRAIGHT
+	#define ISLA_GRID_COST_STRAIGHT 1
+	#define ISLA_GRID_COST_DIAGONAL 1.41421356237309504880
+	#define ISLA_GRID_COST_DIAGONAL3 1.73205080756887729353
+#endif
+
 #if !defined(ISLA_MALLOC)&&!defined(ISLA_REALLOC)&&!defined(ISLA_FREE)
 	#include <stdlib.h>
 	#define ISLA_MALLOC malloc
@@ -66,6 +76,9 @@ struct isla_node {
 typedef isla_node *(*isla_neighbor)( isla_node *, isla_node *, void *userdata );
 typedef isla_cost (*isla_cost_fun)( isla_node *, isla_node *, void *userdata );
 typedef int (*isla_predicate)( isla_node *, void *userdata );
+typedef int (*isla_prune)( isla_node *node, isla_node *neighbor, isla_node *finish, void *userdata );
+typedef int (*isla_cancel)( void *data );
+typedef void (*isla_trace_hook)( isla_node *node, void *data );
 
 typedef enum {
 	ISLA_OK,
@@ -73,6 +86,10 @@ typedef enum {
 	ISLA_ERROR_BAD_ALLOC,
 	ISLA_ERROR_BAD_REALLOC,
 	ISLA_ERROR_BAD_ARGUMENTS,
+	ISLA_LIMIT_REACHED,
+	ISLA_IN_PROGRESS,
+	ISLA_CANCELLED,
+	ISLA_ERROR_IO,
 } isla_status;
 
 typedef struct {
@@ -86,6 +103,37 @@ typedef struct {
 	isla_path *path;
 } isla_result;
 
+typedef struct {
+	isla_path open;
+	isla_path used;
+	size_t min_nodes;
+	size_t shrink_period;
+	size_t queries;
+	size_t peak;
+} isla_workspace;
+
+typedef struct {
+	size_t retained_bytes;
+	size_t open_capacity;
+	size_t used_capacity;
+	size_t peak_nodes;
+} isla_workspace_stats;
+
+#ifdef ISLA_WORKSPACE_POOL
+typedef struct {
+	unsigned char *slots;
+	unsigned long long *heads;
+	size_t shards;
+	size_t per_shard;
+} isla_workspace_pool;
+#endif
+
+typedef enum {
+	ISLA_PARTIAL_NONE,
+	ISLA_PARTIAL_MIN_H,
+	ISLA_PARTIAL_MIN_F,
+} isla_partial;
+
 typedef struct {
 	isla_neighbor next_neighbor;
 	isla_cost_fun eval_cost;
@@ -93,15 +141,479 @@ typedef struct {
 	isla_predicate is_finish_node;
 	isla_path *cache_used;
 	isla_path *cache_open;
+	size_t max_memory;
+	size_t max_expansions;
+	isla_partial partial;
+	isla_workspace *workspace;
+	int reopen_closed;
+	isla_prune prune_neighbor;
+	const volatile int *cancel_flag;
+	isla_cancel is_cancelled;
+	void *cancel_data;
+	size_t cancel_period;
+	const isla_status *backend_status;
+#ifdef ISLA_TRACE
+	isla_trace_hook on_expand;
+	isla_trace_hook on_generate;
+	isla_trace_hook on_update;
+	void *trace_data;
+#endif
 } isla_properties;
 
+typedef struct {
+	isla_node *node;
+	isla_cost cost;
+} isla_reached;
+
+typedef struct {
+	isla_reached *reached;
+	size_t count;
+	size_t allocated;
+} isla_range;
+
+typedef struct {
+	size_t count;
+	isla_cost penalty;
+	double max_overlap;
+	size_t max_attempts;
+	size_t attempts;
+} isla_alternatives;
+
+// Internal hash map, declared here because backends embed it
+typedef struct {
+	size_t key;
+	size_t value;
+} isla__map_entry;
+
+typedef struct {
+	isla__map_entry *entries;
+	size_t mask;
+	size_t count;
+} isla__map;
+
+typedef enum {
+	ISLA_GRID_SQUARE4,
+	ISLA_GRID_SQUARE8,
+	ISLA_GRID_HEX,
+	ISLA_GRID_VOXEL6,
+	ISLA_GRID_VOXEL18,
+	ISLA_GRID_VOXEL26,
+} isla_grid_topology;
+
+typedef struct {
+	isla_grid_topology topology;
+	int width;
+	int height;
+	int depth;
+	size_t stride_y;
+	size_t stride_z;
+	int directions;
+	ptrdiff_t offsets[26];
+	isla_cost costs[26];
+	ptrdiff_t guards[26][7];
+	signed char lookup[27];
+	unsigned char *blocked;
+	isla_node *nodes;
+} isla_grid;
+
+typedef struct {
+	const isla_grid *grid;
+	const unsigned char *code;
+	size_t size;
+	size_t position;
+	size_t index;
+	ptrdiff_t offset;
+	unsigned remaining;
+	isla_status status;
+} isla_grid_code_iter;
+
+typedef struct {
+	isla_grid *grid;
+	size_t count;
+	size_t *cells;
+	isla_node *nodes;
+	size_t *offsets;
+	isla_node **edges;
+	isla__map lookup;
+	isla_path start_edges;
+	isla_path goal_edges;
+	unsigned char *to_goal;
+	unsigned char *band;
+	size_t band_size;
+} isla_subgoal_graph;
+
+#define ISLA_GB_MAGIC 0x42474c49u
+#define ISLA_GB_VERSION 1
+
+typedef struct {
+	unsigned magic;
+	unsigned version;
+	int topology;
+	int width;
+	int height;
+	int directions;
+} isla_gb_header;
+
+typedef struct {
+	isla_grid *grid;
+	const unsigned short *boxes;
+	void *data;
+	size_t size;
+} isla_gb;
+
+#ifndef ISLA_CHUNK_BITS
+	#define ISLA_CHUNK_BITS 6
+#endif
+
+#define ISLA_CHUNK_SIZE (1 << ISLA_CHUNK_BITS)
+
+typedef int (*isla_chunk_loader)( int chunk_x, int chunk_y, unsigned char *blocked, void *userdata );
+
+typedef struct {
+	int chunk_x;
+	int chunk_y;
+	isla_node nodes[ISLA_CHUNK_SIZE * ISLA_CHUNK_SIZE];
+} isla_chunk_page;
+
+typedef struct {
+	size_t key;
+	size_t prev;
+	size_t next;
+	unsigned char blocked[ISLA_CHUNK_SIZE * ISLA_CHUNK_SIZE / 8];
+} isla_chunk_cache_entry;
+
+typedef struct {
+	int width;
+	int height;
+	int diagonal;
+	int chunks_x;
+	isla_chunk_loader loader;
+	void *loader_data;
+	isla__map pages;
+	isla__map cached;
+	isla_chunk_cache_entry *cache;
+	size_t cache_size;
+	size_t cache_used;
+	size_t lru_head;
+	size_t lru_tail;
+	size_t loads;
+	isla_status status;
+} isla_chunked;
+
+typedef size_t (*isla_implicit_successors)( const void *key, void *successors, void *userdata );
+
+typedef struct {
+	size_t key_size;
+	size_t record_size;
+	unsigned char **blocks;
+	size_t blocks_count;
+	size_t blocks_allocated;
+	size_t block_records;
+	size_t block_used;
+	isla_node **table;
+	size_t mask;
+	size_t count;
+	isla_implicit_successors successors;
+	void *userdata;
+	unsigned char *scratch;
+	isla_node *expanded;
+	isla_node *neighbors[ISLA_MAX_NEIGHBORS];
+	size_t neighbors_count;
+	size_t cursor;
+	isla_status status;
+} isla_implicit;
+
+#ifndef ISLA_DH_MAX_LANDMARKS
+	#define ISLA_DH_MAX_LANDMARKS 4
+#endif
+
+typedef struct {
+	isla_node *nodes;
+	size_t count;
+	size_t landmarks;
+	int bits;
+	isla_node *landmark_nodes[ISLA_DH_MAX_LANDMARKS];
+	isla_cost scales[ISLA_DH_MAX_LANDMARKS];
+	void *data;
+	isla_neighbor next_neighbor;
+	isla_cost_fun eval_cost;
+	isla_cost_fun estimate_cost;
+	isla_predicate is_finish_node;
+	void *userdata;
+} isla_dh;
+
+typedef struct {
+	isla_node *nodes;
+	size_t count;
+	unsigned *regions;
+	unsigned regions_count;
+	size_t pruned_nodes;
+	isla_neighbor next_neighbor;
+	isla_cost_fun eval_cost;
+	isla_cost_fun estimate_cost;
+	isla_predicate is_finish_node;
+	void *userdata;
+} isla_deadend;
+
+#ifndef ISLA_APSP_BLOCK
+	#define ISLA_APSP_BLOCK 64
+#endif
+
+#define ISLA_APSP_NONE 0xffffffffu
+
+typedef struct {
+	isla_node *nodes;
+	size_t count;
+	isla_cost *dist;
+	unsigned *next;
+	isla_cost infinity;
+} isla_apsp;
+
+#ifndef ISLA_NO_STDIO
+#ifndef ISLA_EXTERNAL_MAX_OPEN_RUNS
+	#define ISLA_EXTERNAL_MAX_OPEN_RUNS 64
+#endif
+
+typedef struct {
+	const char *directory;
+	size_t buffer_states;
+	size_t locality;
+	size_t max_depth;
+	size_t io_buffer;
+	size_t max_open_runs;
+	size_t expanded;
+	size_t depth;
+	size_t bytes_written;
+} isla_external;
+#endif
+
+#if defined(ISLA_TRACE) && !defined(ISLA_NO_STDIO)
+#ifndef ISLA_TRACE_BUFFER
+	#define ISLA_TRACE_BUFFER 4096
+#endif
+
+#define ISLA_TRACE_MAGIC 0x54534c49u
+#define ISLA_TRACE_VERSION 1
+
+typedef enum {
+	ISLA_TRACE_EXPAND,
+	ISLA_TRACE_GENERATE,
+	ISLA_TRACE_UPDATE,
+	ISLA_TRACE_MARK,
+} isla_trace_event;
+
+typedef struct {
+	void *file;
+	isla_node *origin;
+	size_t length;
+	size_t events;
+	isla_status status;
+	unsigned char buffer[ISLA_TRACE_BUFFER];
+} isla_tracer;
+#endif
+
+#ifdef ISLA_METRICS
+#ifndef ISLA_METRICS_SUB_BITS
+	#define ISLA_METRICS_SUB_BITS 4
+#endif
+
+#ifndef ISLA_METRICS_MAX_BITS
+	#define ISLA_METRICS_MAX_BITS 40
+#endif
+
+#define ISLA_METRICS_BUCKETS ((ISLA_METRICS_MAX_BITS - ISLA_METRICS_SUB_BITS + 1) << ISLA_METRICS_SUB_BITS)
+
+typedef enum {
+	ISLA_METRIC_LATENCY,
+	ISLA_METRIC_EXPANSIONS,
+	ISLA_METRIC_LENGTH,
+} isla_metric;
+
+typedef enum {
+	ISLA_METRICS_TEXT,
+	ISLA_METRICS_PROMETHEUS,
+} isla_metrics_format;
+
+typedef struct {
+	unsigned char *slots;
+	size_t threads;
+	size_t classes;
+} isla_metrics;
+#endif
+
+#ifndef ISLA_NO_STDIO
+#define ISLA_REPLAY_MAGIC 0x524c5349u
+#define ISLA_REPLAY_VERSION 1
+
+typedef struct {
+	void *file;
+	isla__map ids;
+	isla__map expanded;
+	isla__map estimated;
+	isla_node *finish;
+	unsigned char *scratch;
+	size_t scratch_size;
+	unsigned next_id;
+	size_t queries;
+	isla_status status;
+	isla_neighbor next_neighbor;
+	isla_cost_fun eval_cost;
+	isla_cost_fun estimate_cost;
+	isla_predicate is_finish_node;
+	isla_prune prune_neighbor;
+	void *userdata;
+} isla_recorder;
+#endif
+
+typedef struct isla_search isla_search;
+
+typedef void (*isla_callback)( isla_search *, isla_result result, void *userdata );
+
+struct isla_search {
+	isla_node *start;
+	isla_node *finish;
+	isla_properties *properties;
+	void *userdata;
+	isla_path *openlist;
+	isla_path *usedlist;
+	isla_node *closest;
+	size_t expansions;
+	size_t cancel_countdown;
+	isla_result result;
+	isla_callback on_complete;
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 ISLA_DEF isla_result isla_find_path( isla_node *start, isla_node *finish, isla_properties *properties, void *userdata );
+ISLA_DEF isla_status isla_search_begin( isla_search *search, isla_node *start, isla_node *finish, isla_properties *properties, void *userdata );
+ISLA_DEF isla_result isla_search_step( isla_search *search, size_t max_expansions );
+ISLA_DEF void isla_search_abort( isla_search *search );
+ISLA_DEF isla_status isla_find_range( isla_node *start, isla_cost radius, isla_properties *properties, isla_range *range, void *userdata );
+ISLA_DEF void isla_range_destroy( isla_range *range );
+ISLA_DEF size_t isla_find_path_alternatives( isla_node *start, isla_node *finish, isla_properties *properties, isla_alternatives *alternatives, isla_result *results, void *userdata );
+ISLA_DEF isla_result isla_find_path_ida( isla_node *start, isla_node *finish, isla_properties *properties, size_t max_depth, size_t table_size, void *userdata );
+ISLA_DEF isla_result isla_find_path_sma( isla_node *start, isla_node *finish, isla_properties *properties, size_t max_nodes, void *userdata );
 ISLA_DEF void isla_destroy_path( isla_path *path );
+ISLA_DEF isla_status isla_workspace_init( isla_workspace *workspace, size_t expected_nodes, size_t shrink_period );
+ISLA_DEF isla_status isla_workspace_reserve( isla_workspace *workspace, size_t expected_nodes );
+ISLA_DEF void isla_workspace_shrink( isla_workspace *workspace, size_t nodes );
+ISLA_DEF isla_workspace_stats isla_workspace_get_stats( const isla_workspace *workspace );
+ISLA_DEF void isla_workspace_destroy( isla_workspace *workspace );
+#ifdef ISLA_WORKSPACE_POOL
+ISLA_DEF isla_status isla_workspace_pool_init( isla_workspace_pool *pool, size_t shards, size_t per_shard, size_t expected_nodes, size_t shrink_period );
+ISLA_DEF isla_status isla_workspace_pool_prepare_shard( isla_workspace_pool *pool, size_t shard );
+ISLA_DEF isla_workspace *isla_workspace_pool_acquire( isla_workspace_pool *pool, size_t shard );
+ISLA_DEF void isla_workspace_pool_release( isla_workspace_pool *pool, isla_workspace *workspace );
+ISLA_DEF void isla_workspace_pool_destroy( isla_workspace_pool *pool );
+#endif
 ISLA_DEF void isla_reverse_path( isla_path *path );
+ISLA_DEF isla_status isla_grid_init( isla_grid *grid, isla_grid_topology topology, int width, int height, int depth );
+ISLA_DEF void isla_grid_destroy( isla_grid *grid );
+ISLA_DEF void isla_grid_set_blocked( isla_grid *grid, int x, int y, int z, int blocked );
+ISLA_DEF int isla_grid_is_blocked( const isla_grid *grid, int x, int y, int z );
+ISLA_DEF isla_node *isla_grid_node( isla_grid *grid, int x, int y, int z );
+ISLA_DEF void isla_grid_coords( const isla_grid *grid, const isla_node *node, int *x, int *y, int *z );
+ISLA_DEF void isla_grid_properties( isla_grid *grid, isla_properties *properties );
+ISLA_DEF isla_node *isla_grid_next_neighbor( isla_node *node, isla_node *prev, void *grid );
+ISLA_DEF isla_cost isla_grid_eval_cost( isla_node *node1, isla_node *node2, void *grid );
+ISLA_DEF isla_cost isla_grid_estimate_cost( isla_node *node1, isla_node *node2, void *grid );
+ISLA_DEF isla_status isla_grid_encode_path( const isla_grid *grid, const isla_path *path, unsigned char *code, size_t *size );
+ISLA_DEF isla_result isla_grid_decode_path( const isla_grid *grid, const unsigned char *code, size_t size );
+ISLA_DEF void isla_grid_code_begin( isla_grid_code_iter *iter, const isla_grid *grid, const unsigned char *code, size_t size );
+ISLA_DEF isla_node *isla_grid_code_next( isla_grid_code_iter *iter );
+ISLA_DEF isla_status isla_subgoal_init( isla_subgoal_graph *sg, isla_grid *grid );
+ISLA_DEF void isla_subgoal_destroy( isla_subgoal_graph *sg );
+ISLA_DEF isla_result isla_subgoal_find_path( isla_subgoal_graph *sg, int x0, int y0, int x1, int y1, isla_properties *properties );
+ISLA_DEF isla_node *isla_subgoal_next_neighbor( isla_node *node, isla_node *prev, void *sg );
+ISLA_DEF isla_cost isla_subgoal_eval_cost( isla_node *node1, isla_node *node2, void *sg );
+ISLA_DEF isla_status isla_gb_build( isla_gb *gb, isla_grid *grid );
+ISLA_DEF isla_status isla_gb_attach( isla_gb *gb, isla_grid *grid, const void *data, size_t size );
+ISLA_DEF const void *isla_gb_data( const isla_gb *gb, size_t *size );
+ISLA_DEF void isla_gb_destroy( isla_gb *gb );
+ISLA_DEF void isla_gb_properties( isla_gb *gb, isla_properties *properties );
+ISLA_DEF isla_node *isla_gb_next_neighbor( isla_node *node, isla_node *prev, void *gb );
+ISLA_DEF isla_cost isla_gb_eval_cost( isla_node *node1, isla_node *node2, void *gb );
+ISLA_DEF isla_cost isla_gb_estimate_cost( isla_node *node1, isla_node *node2, void *gb );
+ISLA_DEF int isla_gb_prune( isla_node *node, isla_node *neighbor, isla_node *finish, void *gb );
+#ifndef ISLA_NO_STDIO
+ISLA_DEF isla_status isla_gb_save( const isla_gb *gb, const char *path );
+#endif
+ISLA_DEF isla_status isla_chunked_init( isla_chunked *world, int width, int height, int diagonal, size_t cache_chunks, isla_chunk_loader loader, void *loader_data );
+ISLA_DEF void isla_chunked_destroy( isla_chunked *world );
+ISLA_DEF void isla_chunked_release_pages( isla_chunked *world );
+ISLA_DEF void isla_chunked_invalidate( isla_chunked *world, int chunk_x, int chunk_y );
+ISLA_DEF int isla_chunked_is_blocked( isla_chunked *world, int x, int y );
+ISLA_DEF isla_node *isla_chunked_node( isla_chunked *world, int x, int y );
+ISLA_DEF void isla_chunked_coords( const isla_chunked *world, const isla_node *node, int *x, int *y );
+ISLA_DEF void isla_chunked_properties( isla_chunked *world, isla_properties *properties );
+ISLA_DEF isla_node *isla_chunked_next_neighbor( isla_node *node, isla_node *prev, void *world );
+ISLA_DEF isla_cost isla_chunked_eval_cost( isla_node *node1, isla_node *node2, void *world );
+ISLA_DEF isla_cost isla_chunked_estimate_cost( isla_node *node1, isla_node *node2, void *world );
+ISLA_DEF isla_status isla_implicit_init( isla_implicit *graph, size_t key_size, size_t expected_states, isla_implicit_successors successors, void *userdata );
+ISLA_DEF void isla_implicit_destroy( isla_implicit *graph );
+ISLA_DEF void isla_implicit_clear( isla_implicit *graph );
+ISLA_DEF isla_node *isla_implicit_node( isla_implicit *graph, const void *key );
+ISLA_DEF isla_node *isla_implicit_find( const isla_implicit *graph, const void *key );
+ISLA_DEF const void *isla_implicit_key( const isla_node *node );
+ISLA_DEF void isla_implicit_properties( isla_implicit *graph, isla_properties *properties );
+ISLA_DEF isla_node *isla_implicit_next_neighbor( isla_node *node, isla_node *prev, void *graph );
+ISLA_DEF isla_status isla_dh_init( isla_dh *dh, isla_node *nodes, size_t count, isla_node *seed, size_t landmarks, int bits, isla_properties *properties, void *userdata );
+ISLA_DEF void isla_dh_destroy( isla_dh *dh );
+ISLA_DEF size_t isla_dh_memory( const isla_dh *dh );
+ISLA_DEF void isla_dh_properties( isla_dh *dh, isla_properties *properties );
+ISLA_DEF isla_node *isla_dh_next_neighbor( isla_node *node, isla_node *prev, void *dh );
+ISLA_DEF isla_cost isla_dh_eval_cost( isla_node *node1, isla_node *node2, void *dh );
+ISLA_DEF isla_cost isla_dh_estimate_cost( isla_node *node1, isla_node *node2, void *dh );
+ISLA_DEF int isla_dh_is_finish_node( isla_node *node, void *dh );
+ISLA_DEF isla_status isla_deadend_init( isla_deadend *de, isla_node *nodes, size_t count, isla_node *seed, isla_properties *properties, void *userdata );
+ISLA_DEF void isla_deadend_destroy( isla_deadend *de );
+ISLA_DEF unsigned isla_deadend_region( const isla_deadend *de, const isla_node *node );
+ISLA_DEF void isla_deadend_properties( isla_deadend *de, isla_properties *properties );
+ISLA_DEF isla_node *isla_deadend_next_neighbor( isla_node *node, isla_node *prev, void *de );
+ISLA_DEF isla_cost isla_deadend_eval_cost( isla_node *node1, isla_node *node2, void *de );
+ISLA_DEF isla_cost isla_deadend_estimate_cost( isla_node *node1, isla_node *node2, void *de );
+ISLA_DEF int isla_deadend_is_finish_node( isla_node *node, void *de );
+ISLA_DEF int isla_deadend_prune( isla_node *node, isla_node *neighbor, isla_node *finish, void *de );
+ISLA_DEF isla_status isla_apsp_init( isla_apsp *apsp, isla_node *nodes, size_t count, isla_properties *properties, void *userdata );
+ISLA_DEF void isla_apsp_destroy( isla_apsp *apsp );
+ISLA_DEF int isla_apsp_reachable( const isla_apsp *apsp, isla_node *start, isla_node *finish );
+ISLA_DEF isla_cost isla_apsp_distance( const isla_apsp *apsp, isla_node *start, isla_node *finish );
+ISLA_DEF isla_node *isla_apsp_next_hop( const isla_apsp *apsp, isla_node *start, isla_node *finish );
+ISLA_DEF isla_result isla_apsp_path( const isla_apsp *apsp, isla_node *start, isla_node *finish );
+#if defined(ISLA_TRACE) && !defined(ISLA_NO_STDIO)
+ISLA_DEF isla_status isla_tracer_open( isla_tracer *tracer, const char *path, isla_node *origin, int stride, int width, int height );
+ISLA_DEF void isla_tracer_mark( isla_tracer *tracer, unsigned value );
+ISLA_DEF void isla_tracer_properties( isla_tracer *tracer, isla_properties *properties );
+ISLA_DEF isla_status isla_tracer_close( isla_tracer *tracer );
+#endif
+#ifdef ISLA_METRICS
+ISLA_DEF isla_status isla_metrics_init( isla_metrics *metrics, size_t threads, size_t classes );
+ISLA_DEF void isla_metrics_destroy( isla_metrics *metrics );
+ISLA_DEF void isla_metrics_record( isla_metrics *metrics, size_t thread, size_t query_class, isla_status status, unsigned long long latency_ns, size_t expansions, size_t length );
+ISLA_DEF isla_result isla_find_path_measured( isla_metrics *metrics, size_t thread, size_t query_class, isla_node *start, isla_node *finish, isla_properties *properties, void *userdata );
+ISLA_DEF unsigned long long isla_metrics_count( const isla_metrics *metrics, size_t query_class, int failures );
+ISLA_DEF unsigned long long isla_metrics_percentile( const isla_metrics *metrics, size_t query_class, isla_metric metric, double percentile );
+#ifndef ISLA_NO_STDIO
+ISLA_DEF isla_status isla_metrics_export( const isla_metrics *metrics, const char *path, const char *const *class_names, isla_metrics_format format );
+#endif
+#endif
+#ifndef ISLA_NO_STDIO
+ISLA_DEF isla_status isla_recorder_open( isla_recorder *recorder, const char *path, isla_properties *properties, void *userdata );
+ISLA_DEF void isla_recorder_properties( isla_recorder *recorder, isla_properties *properties );
+ISLA_DEF void isla_recorder_begin( isla_recorder *recorder, isla_node *start, isla_node *finish );
+ISLA_DEF void isla_recorder_end( isla_recorder *recorder, const isla_result *result );
+ISLA_DEF isla_result isla_find_path_recorded( isla_recorder *recorder, isla_node *start, isla_node *finish, isla_properties *properties );
+ISLA_DEF isla_status isla_recorder_close( isla_recorder *recorder );
+ISLA_DEF isla_node *isla_recorder_next_neighbor( isla_node *node, isla_node *prev, void *recorder );
+ISLA_DEF isla_cost isla_recorder_eval_cost( isla_node *node1, isla_node *node2, void *recorder );
+ISLA_DEF isla_cost isla_recorder_estimate_cost( isla_node *node1, isla_node *node2, void *recorder );
+ISLA_DEF int isla_recorder_is_finish_node( isla_node *node, void *recorder );
+ISLA_DEF int isla_recorder_prune( isla_node *node, isla_node *neighbor, isla_node *finish, void *recorder );
+ISLA_DEF isla_result isla_find_path_external( isla_implicit *graph, const void *start, const void *finish, isla_external *external );
+#endif
 ISLA_DEF const char *isla_strstatus( isla_status status );
 
 #ifdef __cplusplus
@@ -112,6 +624,69 @@ ISLA_DEF const char *isla_strstatus( isla_status status );
 
 #ifdef ISL_ASTAR_IMPLEMENTATION
 
+#ifndef ISLA_NO_STDIO
+	#include <stdio.h>
+	#include <time.h>
+	#if defined(_WIN32)
+		#include <process.h>
+		#define ISLA__GETPID() ((unsigned long) _getpid())
+	#elif defined(__unix__) || defined(__APPLE__)
+		#include <unistd.h>
+		#define ISLA__GETPID() ((unsigned long) getpid())
+	#else
+		#define ISLA__GETPID() 0ul
+	#endif
+#endif
+
+#if defined(ISLA_METRICS) && !defined(ISLA_METRICS_NOW)
+	#if defined(_WIN32)
+		#include <windows.h>
+	#else
+		#include <time.h>
+	#endif
+#endif
+
+// Software prefetch of search state is opt-in, it pays off only when nodes don't fit in cache
+#ifdef ISLA_PREFETCH
+	#ifndef ISLA_PREFETCH_BATCH
+		#define ISLA_PREFETCH_BATCH ISLA_MAX_NEIGHBORS
+	#endif
+	#if defined(__GNUC__) || defined(__clang__)
+		#define ISLA__PREFETCH(p) __builtin_prefetch( (p), 1, 3 )
+	#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+		#include <xmmintrin.h>
+		#define ISLA__PREFETCH(p) _mm_prefetch( (const char *) (p), _MM_HINT_T0 )
+	#else
+		#define ISLA__PREFETCH(p) ((void) (p))
+	#endif
+#endif
+
+// Data shared between threads is padded to cache line to prevent false sharing
+#define ISLA__CACHE_LINE 64
+
+// Atomic loads and stores of GCC/Clang or MSVC, features built on them are opt-in and can't
+// be enabled without them
+#ifndef ISLA_NO_ATOMICS
+#if defined(_MSC_VER)
+	#define ISLA__ATOMICS
+	#include <intrin.h>
+	#define ISLA__LOAD(p) (*(volatile unsigned long long *)(p))
+	#define ISLA__LOAD32(p) (*(volatile unsigned *)(p))
+	#define ISLA__LOAD_INT(p) (*(const volatile int *)(p))
+	#define ISLA__STORE32(p,v) (*(volatile unsigned *)(p) = (v))
+	#define ISLA__LOAD64(p) (*(volatile unsigned long long *)(p))
+	#define ISLA__STORE64(p,v) (*(volatile unsigned long long *)(p) = (v))
+#elif defined(__GNUC__) || defined(__clang__)
+	#define ISLA__ATOMICS
+	#define ISLA__LOAD(p) __atomic_load_n( (p), __ATOMIC_ACQUIRE )
+	#define ISLA__LOAD32(p) __atomic_load_n( (p), __ATOMIC_RELAXED )
+	#define ISLA__LOAD_INT(p) __atomic_load_n( (p), __ATOMIC_RELAXED )
+	#define ISLA__STORE32(p,v) __atomic_store_n( (p), (v), __ATOMIC_RELAXED )
+	#define ISLA__LOAD64(p) __atomic_load_n( (p), __ATOMIC_RELAXED )
+	#define ISLA__STORE64(p,v) __atomic_store_n( (p), (v), __ATOMIC_RELAXED )
+#endif
+#endif
+
 // Minimal dynamic vector implementation for path storage
 static isla_path *isla__path_create( size_t n ) {
 	isla_path *path = ISLA_MALLOC( sizeof *path );
@@ -205,11 +780,26 @@ static size_t isla__heap_siftup( isla_path *heap, size_t index ) {
 	return index;
 }
 
+#ifdef ISLA_PREFETCH
+// Grandchildren are compared on the next level, their nodes are requested while this level is processed
+static void isla__heap_prefetch( isla_path *heap, size_t index ) {
+	size_t i = (index << 2) + 3;
+	size_t last = i + 4 < heap->length ? i + 4 : heap->length;
+	for ( ; i < last; i++ ) {
+		ISLA__PREFETCH( heap->nodes[i] );
+	}
+}
+#else
+	#define isla__heap_prefetch(heap,index) do { } while ( 0 )
+#endif
+
 static void isla__heap_siftdown_floyd( isla_path *heap, size_t index ) {
 	size_t left = (index << 1) + 1;
 	size_t right = left + 1;
 	while ( left < heap->length ) {
-		size_t higher = ( right < heap->length && heap->nodes[right]->f < heap->nodes[left]->f ) ? right : left;
+		size_t higher;
+		isla__heap_prefetch( heap, index );
+		higher = ( right < heap->length && heap->nodes[right]->f < heap->nodes[left]->f ) ? right : left;
 		isla__heap_swap( heap, index, higher );
 		index = higher;
 		left = (index << 1) + 1;
@@ -222,7 +812,9 @@ static void isla__heap_siftdown( isla_path *heap, size_t index ) {
 	size_t left = (index << 1) + 1;
 	size_t right = left + 1;
 	while ( left < heap->length ) {
-		size_t higher = ( right < heap->length && heap->nodes[right]->f < heap->nodes[left]->f ) ? right : left;
+		size_t higher;
+		isla__heap_prefetch( heap, index );
+		higher = ( right < heap->length && heap->nodes[right]->f < heap->nodes[left]->f ) ? right : left;
 		if ( heap->nodes[index]->f < heap->nodes[higher]->f ) 
 			break;
 		isla__heap_swap( heap, index, higher );
@@ -235,6 +827,7 @@ static void isla__heap_siftdown( isla_path *heap, size_t index ) {
 static isla_status isla__heap_enqueue( isla_path *heap, isla_node *node ) {
 	isla_status status = isla__path_push( heap, node );
 	if ( status == ISLA_OK ) {
+		node->index = heap->length-1;
 		isla__heap_siftup( heap, heap->length-1 );
 	}
 	return status;
@@ -257,127 +850,4657 @@ static isla_node *isla__heap_dequeue( isla_path *heap ) {
 static void isla__heap_update( isla_path *heap, isla_node *node ) {
 	isla__heap_siftdown( heap, isla__heap_siftup( heap, node->index ));
 }
+
+static void isla__heap_remove( isla_path *heap, isla_node *node ) {
+	size_t index = node->index;
+	if ( index < --heap->length ) {
+		isla__heap_swap( heap, index, heap->length );
+		isla__heap_update( heap, heap->nodes[index] );
+	}
+}
 // End of binary heap implementation
 
 
-static void isla__cleanup( isla_path *used, isla_path *open, int cached ) {
+// Open addressing hash map with linear probing, zero key is reserved for empty slots
+
+static size_t isla__hash( size_t key ) {
+	key ^= (key >> 16) >> 16;
+	key ^= key >> 16;
+	key *= 0x45d9f3bu;
+	key ^= key >> 16;
+	key *= 0x45d9f3bu;
+	key ^= key >> 16;
+	return key;
+}
+
+static isla_status isla__map_alloc( isla__map *map, size_t capacity ) {
 	size_t i;
-	for ( i = 0; i < used->length; i++ ) {
-		isla_node *node = used->nodes[i];
-		node->g = 0;
-		node->f = 0;
-		node->status = ISLA_NODE_DEFAULT;
-		node->parent = NULL;
-		node->index = 0;
-	}
-	if ( cached ) {
-		used->length = 0;
-		open->length = 0;
-	} else {
-		isla_destroy_path( used );
-		isla_destroy_path( open );
+	map->entries = ISLA_MALLOC( capacity * sizeof( *map->entries ));
+	if ( map->entries == NULL ) {
+		return ISLA_ERROR_BAD_ALLOC;
 	}
+	for ( i = 0; i < capacity; i++ ) {
+		map->entries[i].key = 0;
+	}
+	map->mask = capacity - 1;
+	map->count = 0;
+	return ISLA_OK;
 }
 
-static isla_result isla__build_path( isla_node *node ) {
-	isla_result result = {ISLA_OK, isla__path_create(4)};
+static isla_status isla__map_init( isla__map *map, size_t expected ) {
+	size_t capacity = 8;
+	while ( capacity < expected * 2 ) {
+		capacity <<= 1;
+	}
+	return isla__map_alloc( map, capacity );
+}
 
-	if ( result.path == NULL ) {
-		result.status = ISLA_ERROR_BAD_ALLOC;
-		return result;
+static void isla__map_clear( isla__map *map ) {
+	size_t i;
+	for ( i = 0; i <= map->mask; i++ ) {
+		map->entries[i].key = 0;
 	}
+	map->count = 0;
+}
 
-	do {
-		result.status =  isla__path_push( result.path, node );
-		if ( result.status != ISLA_OK ) {
-			isla_destroy_path( result.path );
-			result.path = NULL;
-			return result;
-		}
-		node = node->parent;
-	} while ( node != NULL );
+static void isla__map_destroy( isla__map *map ) {
+	ISLA_FREE( map->entries );
+	map->entries = NULL;
+	map->count = 0;
+}
 
-	return result;
+static size_t *isla__map_get( isla__map *map, size_t key ) {
+	size_t i = isla__hash( key ) & map->mask;
+	while ( map->entries[i].key != 0 ) {
+		if ( map->entries[i].key == key ) {
+			return &map->entries[i].value;
+		}
+		i = (i + 1) & map->mask;
+	}
+	return NULL;
 }
 
-isla_result isla_find_path( isla_node *start, isla_node *finish, isla_properties *properties, void *userdata ) {
-	int cached = 0;
-	isla_path *openlist;
-	isla_path *usedlist;
-	isla_result result = {ISLA_OK,NULL};
+static isla_status isla__map_put( isla__map *map, size_t key, size_t value ) {
+	size_t i;
+	if ( (map->count + 1) * 2 > map->mask + 1 ) {
+		isla__map old = *map;
+		isla_status status = isla__map_alloc( map, (old.mask + 1) * 2 );
+		if ( status != ISLA_OK ) {
+			*map = old;
+			return status;
+		}
+		for ( i = 0; i <= old.mask; i++ ) {
+			if ( old.entries[i].key != 0 ) {
+				isla__map_put( map, old.entries[i].key, old.entries[i].value );
+			}
+		}
+		ISLA_FREE( old.entries );
+	}
+	i = isla__hash( key ) & map->mask;
+	while ( map->entries[i].key != 0 && map->entries[i].key != key ) {
+		i = (i + 1) & map->mask;
+	}
+	if ( map->entries[i].key == 0 ) {
+		map->count++;
+	}
+	map->entries[i].key = key;
+	map->entries[i].value = value;
+	return ISLA_OK;
+}
 
-	if ( start == NULL || finish == NULL || properties == NULL ) {
-		result.status = ISLA_ERROR_BAD_ARGUMENTS;
-		return result;
+static void isla__map_remove( isla__map *map, size_t key ) {
+	size_t i = isla__hash( key ) & map->mask;
+	size_t j;
+	while ( map->entries[i].key != key ) {
+		if ( map->entries[i].key == 0 ) {
+			return;
+		}
+		i = (i + 1) & map->mask;
+	}
+	map->count--;
+	// Backward shift deletion keeps probe sequences intact without tombstones
+	for ( j = (i + 1) & map->mask; map->entries[j].key != 0; j = (j + 1) & map->mask ) {
+		size_t home = isla__hash( map->entries[j].key ) & map->mask;
+		if ( ((j - home) & map->mask) >= ((j - i) & map->mask) ) {
+			map->entries[i] = map->entries[j];
+			i = j;
+		}
 	}
+	map->entries[i].key = 0;
+}
+// End of hash map implementation
 
-	cached = properties->cache_open != NULL && properties->cache_used != NULL;
+typedef union {
+	size_t s;
+	double d;
+	void *p;
+} isla__align;
 
-	openlist = cached ? properties->cache_open : isla__path_create( ISLA_MAX_NEIGHBORS );
-	usedlist = cached ? properties->cache_used : isla__path_create( 4 );
+#define ISLA__ALIGN(n) (((n) + sizeof( isla__align ) - 1) / sizeof( isla__align ) * sizeof( isla__align ))
 
-	if ( openlist == NULL || usedlist == NULL ) {
-		isla_destroy_path( openlist );
-		isla_destroy_path( usedlist );
-		result.status = ISLA_ERROR_BAD_ALLOC; 
-		return result;
+
+static void isla__reset_node( isla_node *node ) {
+	node->g = 0;
+	node->f = 0;
+	node->status = ISLA_NODE_DEFAULT;
+	node->parent = NULL;
+	node->index = 0;
+}
+
+static int isla__is_finish( isla_node *node, isla_node *finish, isla_properties *properties, void *userdata ) {
+	return node == finish || (properties->is_finish_node != NULL && properties->is_finish_node( node, userdata ));
+}
+
+// Reusable search lists, after every shrink_period queries buffers are shrunk to the peak usage
+isla_status isla_workspace_reserve( isla_workspace *workspace, size_t expected_nodes ) {
+	isla_status status = ISLA_OK;
+	if ( workspace->used.allocated < expected_nodes ) {
+		status = isla__path_grow( &workspace->used, expected_nodes );
+	}
+	if ( status == ISLA_OK && workspace->open.allocated < expected_nodes ) {
+		status = isla__path_grow( &workspace->open, expected_nodes );
 	}
+	return status;
+}
 
-	result.status = isla__heap_enqueue( openlist, start );
-	if ( result.status != ISLA_OK ) {
-		isla__cleanup( usedlist, openlist, cached );
-		return result;
+isla_status isla_workspace_init( isla_workspace *workspace, size_t expected_nodes, size_t shrink_period ) {
+	isla_status status;
+	workspace->open.nodes = NULL;
+	workspace->open.allocated = 0;
+	workspace->open.length = 0;
+	workspace->used = workspace->open;
+	workspace->min_nodes = expected_nodes < ISLA_MAX_NEIGHBORS ? ISLA_MAX_NEIGHBORS : expected_nodes;
+	workspace->shrink_period = shrink_period;
+	workspace->queries = 0;
+	workspace->peak = 0;
+	status = isla_workspace_reserve( workspace, workspace->min_nodes );
+	if ( status != ISLA_OK ) {
+		isla_workspace_destroy( workspace );
 	}
+	return status;
+}
 
-	start->g = 0;
-	start->f = properties->estimate_cost( start, finish, userdata );
+void isla_workspace_shrink( isla_workspace *workspace, size_t nodes ) {
+	nodes = nodes < workspace->min_nodes ? workspace->min_nodes : nodes;
+	// Keep some slack, otherwise similar queries will realloc back and forth
+	if ( workspace->used.allocated > 2 * nodes ) {
+		isla__path_grow( &workspace->used, nodes );
+	}
+	if ( workspace->open.allocated > 2 * nodes ) {
+		isla__path_grow( &workspace->open, nodes );
+	}
+}
 
-	while ( openlist->length > 0 ) {
-		int i; 
-		int count;
-	 	isla_node *node = isla__heap_dequeue( openlist );
-		isla_node *neighbor = NULL;
-		node->status = ISLA_NODE_CLOSED;
+isla_workspace_stats isla_workspace_get_stats( const isla_workspace *workspace ) {
+	isla_workspace_stats stats;
+	stats.open_capacity = workspace->open.allocated;
+	stats.used_capacity = workspace->used.allocated;
+	stats.retained_bytes = (stats.open_capacity + stats.used_capacity) * sizeof( isla_node * );
+	stats.peak_nodes = workspace->peak;
+	return stats;
+}
 
-		if ( node == finish || (properties->is_finish_node != NULL && properties->is_finish_node( node, userdata ))) {
-			result = isla__build_path( finish );
-			isla__cleanup( usedlist, openlist, cached );
-			return result;
-		}
+void isla_workspace_destroy( isla_workspace *workspace ) {
+	ISLA_FREE( workspace->open.nodes );
+	ISLA_FREE( workspace->used.nodes );
+	workspace->open.nodes = NULL;
+	workspace->used.nodes = NULL;
+	workspace->open.allocated = 0;
+	workspace->used.allocated = 0;
+}
 
-		while ( (neighbor = properties->next_neighbor( node, neighbor, userdata ))) {
-			if ( neighbor->status != ISLA_NODE_CLOSED ) {
-				isla_cost g = node->g + properties->eval_cost( node, neighbor, userdata );
-				if ( neighbor->status == ISLA_NODE_DEFAULT || g < neighbor->g ) {
-					neighbor->g = g;
-					neighbor->f = g + properties->estimate_cost( node, finish, userdata );
-					neighbor->parent = node;
-					if ( neighbor->status == ISLA_NODE_OPENED ) {
-						isla__heap_update( openlist, neighbor );
-					} else {
-						neighbor->status = ISLA_NODE_OPENED;
-						result.status = isla__heap_enqueue( usedlist, neighbor );
-						if ( result.status != ISLA_OK ) {
-							isla__cleanup( usedlist, openlist, cached );
-							return result;
-						}
-						result.status = isla__path_push( openlist, neighbor );
-						if ( result.status != ISLA_OK ) {
-							isla__cleanup( usedlist, openlist, cached );
-							return result;
-						}
-					}
-				}
-			}
+#ifdef ISLA_WORKSPACE_POOL
+#if !defined(ISLA__ATOMICS)
+	#error "ISLA_WORKSPACE_POOL needs GCC/Clang or MSVC atomics"
+#elif defined(_MSC_VER)
+	static int isla__cas( unsigned long long *p, unsigned long long *expected, unsigned long long desired ) {
+		unsigned long long old = (unsigned long long) _InterlockedCompareExchange64( (volatile __int64 *) p, (__int64) desired, (__int64) *expected );
+		if ( old == *expected ) {
+			return 1;
 		}
+		*expected = old;
+		return 0;
 	}
+#else
+	#define isla__cas(p,expected,desired) __atomic_compare_exchange_n( (p), (expected), (desired), 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE )
+#endif
 
-	result.status = ISLA_BLOCKED;
-	isla__cleanup( usedlist, openlist, cached );
+// Workspace pool is a set of lock-free stacks (one per shard, i.e. NUMA node), each head
+// packs ABA tag in the upper half and index + 1 of the top slot in the lower half. Slots
+// and heads are padded to cache line to prevent false sharing between threads.
+#define ISLA__POOL_STRIDE ((sizeof( isla_workspace ) + sizeof( unsigned ) + ISLA__CACHE_LINE - 1) / ISLA__CACHE_LINE * ISLA__CACHE_LINE)
+#define ISLA__POOL_HEAD_STRIDE (ISLA__CACHE_LINE / sizeof( unsigned long long ))
 
-	return result;
+static isla_workspace *isla__pool_workspace( isla_workspace_pool *pool, size_t index ) {
+	return (isla_workspace *) (pool->slots + index * ISLA__POOL_STRIDE);
+}
+
+static unsigned *isla__pool_next( isla_workspace_pool *pool, size_t index ) {
+	return (unsigned *) (pool->slots + index * ISLA__POOL_STRIDE + sizeof( isla_workspace ));
+}
+
+static void isla__pool_push( isla_workspace_pool *pool, size_t shard, size_t index ) {
+	unsigned long long *head = pool->heads + shard * ISLA__POOL_HEAD_STRIDE;
+	unsigned long long old = ISLA__LOAD( head );
+	unsigned long long desired;
+	do {
+		ISLA__STORE32( isla__pool_next( pool, index ), (unsigned) (old & 0xffffffffu));
+		desired = ((old >> 32) + 1) << 32 | (unsigned long long) (index + 1);
+	} while ( !isla__cas( head, &old, desired ));
+}
+
+static isla_workspace *isla__pool_pop( isla_workspace_pool *pool, size_t shard ) {
+	unsigned long long *head = pool->heads + shard * ISLA__POOL_HEAD_STRIDE;
+	unsigned long long old = ISLA__LOAD( head );
+	unsigned long long desired;
+	size_t index;
+	do {
+		if ( (old & 0xffffffffu) == 0 ) {
+			return NULL;
+		}
+		index = (size_t) (old & 0xffffffffu) - 1;
+		desired = ((old >> 32) + 1) << 32 | ISLA__LOAD32( isla__pool_next( pool, index ));
+	} while ( !isla__cas( head, &old, desired ));
+	return isla__pool_workspace( pool, index );
 }
 
+isla_status isla_workspace_pool_init( isla_workspace_pool *pool, size_t shards, size_t per_shard, size_t expected_nodes, size_t shrink_period ) {
+	size_t i;
+	size_t count = shards * per_shard;
+	if ( shards == 0 || per_shard == 0 || count >= 0xffffffffu ) {
+		return ISLA_ERROR_BAD_ARGUMENTS;
+	}
+	pool->shards = shards;
+	pool->per_shard = per_shard;
+	pool->slots = ISLA_MALLOC( count * ISLA__POOL_STRIDE );
+	pool->heads = ISLA_MALLOC( shards * ISLA__CACHE_LINE );
+	if ( pool->slots == NULL || pool->heads == NULL ) {
+		ISLA_FREE( pool->slots );
+		ISLA_FREE( pool->heads );
+		return ISLA_ERROR_BAD_ALLOC;
+	}
+	for ( i = 0; i < shards; i++ ) {
+		pool->heads[i * ISLA__POOL_HEAD_STRIDE] = 0;
+	}
+	for ( i = 0; i < count; i++ ) {
+		if ( isla_workspace_init( isla__pool_workspace( pool, i ), expected_nodes, shrink_period ) != ISLA_OK ) {
+			while ( i-- > 0 ) {
+				isla_workspace_destroy( isla__pool_workspace( pool, i ));
+			}
+			ISLA_FREE( pool->slots );
+			ISLA_FREE( pool->heads );
+			return ISLA_ERROR_BAD_ALLOC;
+		}
+	}
+	for ( i = count; i > 0; i-- ) {
+		isla__pool_push( pool, (i - 1) / per_shard, i - 1 );
+	}
+	return ISLA_OK;
+}
+
+// Moves list into fresh buffer touched by the calling thread, old one is freed only after
+// the new one is in place, so on failure the list keeps its buffer and capacity
+static isla_status isla__path_retouch( isla_path *path, size_t n ) {
+	isla_node **nodes = ISLA_MALLOC( n * sizeof( *nodes ));
+	size_t i;
+	if ( nodes == NULL ) {
+		return ISLA_ERROR_BAD_ALLOC;
+	}
+	for ( i = 0; i < n; i++ ) {
+		nodes[i] = NULL;
+	}
+	ISLA_FREE( path->nodes );
+	path->nodes = nodes;
+	path->allocated = n;
+	path->length = 0;
+	return ISLA_OK;
+}
+
+// Reallocates and touches buffers of the shard from the calling thread. With first-touch
+// policy pages end up on the NUMA node of the caller, so call it from a thread pinned to
+// the node before the pool is shared. Each list keeps its own capacity, but at least
+// min_nodes of the workspace, on failure the rest of the shard is still prepared.
+isla_status isla_workspace_pool_prepare_shard( isla_workspace_pool *pool, size_t shard ) {
+	isla_status status = ISLA_OK;
+	size_t i;
+	for ( i = shard * pool->per_shard; i < (shard + 1) * pool->per_shard; i++ ) {
+		isla_workspace *workspace = isla__pool_workspace( pool, i );
+		size_t used = workspace->used.allocated > workspace->min_nodes ? workspace->used.allocated : workspace->min_nodes;
+		size_t open = workspace->open.allocated > workspace->min_nodes ? workspace->open.allocated : workspace->min_nodes;
+		isla_status local = isla__path_retouch( &workspace->used, used );
+		if ( local == ISLA_OK ) {
+			local = isla__path_retouch( &workspace->open, open );
+		}
+		if ( local != ISLA_OK ) {
+			isla_workspace_reserve( workspace, workspace->min_nodes );
+			status = local;
+		}
+	}
+	return status;
+}
+
+// Takes workspace from the preferred shard, steals from others if it is empty, returns
+// NULL if the whole pool is exhausted
+isla_workspace *isla_workspace_pool_acquire( isla_workspace_pool *pool, size_t shard ) {
+	size_t i;
+	for ( i = 0; i < pool->shards; i++ ) {
+		isla_workspace *workspace = isla__pool_pop( pool, (shard + i) % pool->shards );
+		if ( workspace != NULL ) {
+			return workspace;
+		}
+	}
+	return NULL;
+}
+
+// Workspace always returns to its home shard
+void isla_workspace_pool_release( isla_workspace_pool *pool, isla_workspace *workspace ) {
+	size_t index = (size_t) ((unsigned char *) workspace - pool->slots) / ISLA__POOL_STRIDE;
+	isla__pool_push( pool, index / pool->per_shard, index );
+}
+
+void isla_workspace_pool_destroy( isla_workspace_pool *pool ) {
+	size_t i;
+	for ( i = 0; i < pool->shards * pool->per_shard; i++ ) {
+		isla_workspace_destroy( isla__pool_workspace( pool, i ));
+	}
+	ISLA_FREE( pool->slots );
+	ISLA_FREE( pool->heads );
+	pool->slots = NULL;
+	pool->heads = NULL;
+}
+#endif
+
+static void isla__workspace_release( isla_workspace *workspace, size_t reached ) {
+	workspace->open.length = 0;
+	workspace->used.length = 0;
+	if ( reached > workspace->peak ) {
+		workspace->peak = reached;
+	}
+	if ( workspace->shrink_period > 0 && ++workspace->queries >= workspace->shrink_period ) {
+		isla_workspace_shrink( workspace, workspace->peak );
+		workspace->queries = 0;
+		workspace->peak = 0;
+	}
+}
+
+static void isla__cleanup( isla_path *used, isla_path *open, isla_properties *properties ) {
+	size_t i;
+	for ( i = 0; i < used->length; i++ ) {
+		isla__reset_node( used->nodes[i] );
+	}
+	if ( properties->workspace != NULL ) {
+		isla__workspace_release( properties->workspace, used->length );
+		return;
+	}
+	if ( used == properties->cache_used ) {
+		used->length = 0;
+	} else {
+		isla_destroy_path( used );
+	}
+	if ( open == properties->cache_open ) {
+		open->length = 0;
+	} else {
+		isla_destroy_path( open );
+	}
+}
+
+static isla_result isla__build_path( isla_node *node ) {
+	isla_result result = {ISLA_OK, isla__path_create(4)};
+
+	if ( result.path == NULL ) {
+		result.status = ISLA_ERROR_BAD_ALLOC;
+		return result;
+	}
+
+	do {
+		result.status =  isla__path_push( result.path, node );
+		if ( result.status != ISLA_OK ) {
+			isla_destroy_path( result.path );
+			result.path = NULL;
+			return result;
+		}
+		node = node->parent;
+	} while ( node != NULL );
+
+	return result;
+}
+
+// Node which partial path leads to, by default it's the node closest to the finish by estimate
+static int isla__is_closer( isla_node *node, isla_node *closest, isla_partial partial ) {
+	if ( partial == ISLA_PARTIAL_MIN_F ) {
+		return node->f < closest->f || (node->f == closest->f && node->g > closest->g);
+	} else {
+		return node->f - node->g < closest->f - closest->g;
+	}
+}
+
+// Checks that lists can take one more node without exceeding memory ceiling. Only growth is
+// limited, capacity already retained by workspace or caches never refuses a node.
+static int isla__within_memory( isla_path *usedlist, isla_path *openlist, size_t max_memory ) {
+	size_t used = usedlist->allocated;
+	size_t open = openlist->allocated;
+	int grows = 0;
+	if ( max_memory == 0 ) {
+		return 1;
+	}
+	if ( usedlist->length >= used ) {
+		used *= 2;
+		grows = 1;
+	}
+	if ( openlist->length >= open ) {
+		open *= 2;
+		grows = 1;
+	}
+	return !grows || (used + open) * sizeof( isla_node * ) <= max_memory;
+}
+
+#ifdef ISLA_TRACE
+	#define ISLA__TRACE(properties,hook,node) do { if ( (properties)->hook != NULL ) (properties)->hook( (node), (properties)->trace_data ); } while ( 0 )
+#else
+	#define ISLA__TRACE(properties,hook,node) do { } while ( 0 )
+#endif
+
+#ifdef ISLA_PREFETCH
+typedef struct {
+	isla_node *nodes[ISLA_PREFETCH_BATCH];
+	size_t count;
+	size_t cursor;
+} isla__batch;
+
+// Successors are enumerated in batches and prefetched, so cache misses on their status and g
+// overlap instead of stalling relaxation one by one. Batch is refilled after its last node
+// only if it was full, otherwise the enumeration is over.
+static isla_node *isla__batch_next( isla__batch *batch, isla_node *node, isla_node *prev, isla_properties *properties, void *userdata ) {
+	if ( prev == NULL || batch->cursor == batch->count ) {
+		if ( prev != NULL && batch->count < ISLA_PREFETCH_BATCH ) {
+			return NULL;
+		}
+		batch->count = 0;
+		batch->cursor = 0;
+		while ( batch->count < ISLA_PREFETCH_BATCH && (prev = properties->next_neighbor( node, prev, userdata )) != NULL ) {
+			ISLA__PREFETCH( prev );
+			batch->nodes[batch->count++] = prev;
+		}
+		if ( batch->count == 0 ) {
+			return NULL;
+		}
+	}
+	return batch->nodes[batch->cursor++];
+}
+
+	#define ISLA__NEXT_NEIGHBOR(node,prev) isla__batch_next( &batch, (node), (prev), properties, userdata )
+#else
+	#define ISLA__NEXT_NEIGHBOR(node,prev) properties->next_neighbor( (node), (prev), userdata )
+#endif
+
+// Cancellation is polled every cancel_period expansions, flag can be set from any thread, so
+// it's read by relaxed atomic load (volatile read only where atomics are unknown)
+#ifndef ISLA__LOAD_INT
+	#define ISLA__LOAD_INT(p) (*(p))
+#endif
+
+static size_t isla__cancel_period( isla_properties *properties ) {
+	return properties->cancel_period > 0 ? properties->cancel_period : ISLA_CANCEL_PERIOD;
+}
+
+// Backends which allocate nodes on the fly (chunked world, implicit graph) skip a neighbor they
+// couldn't allocate and keep the error in sticky status, so it's checked on every expansion and
+// search which missed a neighbor returns that error instead of a possibly wrong result
+static isla_status isla__backend_status( const isla_properties *properties ) {
+	return properties->backend_status != NULL ? *properties->backend_status : ISLA_OK;
+}
+
+static isla_result isla__backend_result( const isla_properties *properties, isla_result result ) {
+	isla_status status = isla__backend_status( properties );
+	if ( status != ISLA_OK && result.status != ISLA_CANCELLED ) {
+		isla_destroy_path( result.path );
+		result.status = status;
+		result.path = NULL;
+	}
+	return result;
+}
+
+static isla_status isla__poll_cancel( isla_properties *properties, size_t *countdown ) {
+	isla_status status = isla__backend_status( properties );
+	if ( status != ISLA_OK ) {
+		return status;
+	}
+	if ( properties->cancel_flag == NULL && properties->is_cancelled == NULL ) {
+		return ISLA_OK;
+	}
+	if ( --*countdown > 0 ) {
+		return ISLA_OK;
+	}
+	*countdown = isla__cancel_period( properties );
+	return (properties->cancel_flag != NULL && ISLA__LOAD_INT( properties->cancel_flag )) || (properties->is_cancelled != NULL && properties->is_cancelled( properties->cancel_data )) ? ISLA_CANCELLED : ISLA_OK;
+}
+
+// Search lists are taken from the workspace, caches or allocated, in this order
+static isla_status isla__acquire_lists( isla_properties *properties, isla_path **openlist, isla_path **usedlist ) {
+	if ( properties->workspace != NULL ) {
+		*openlist = &properties->workspace->open;
+		*usedlist = &properties->workspace->used;
+	} else {
+		*openlist = properties->cache_open != NULL ? properties->cache_open : isla__path_create( ISLA_MAX_NEIGHBORS );
+		*usedlist = properties->cache_used != NULL ? properties->cache_used : isla__path_create( 4 );
+	}
+
+	if ( *openlist == NULL || *usedlist == NULL ) {
+		if ( *openlist != properties->cache_open ) {
+			isla_destroy_path( *openlist );
+		}
+		if ( *usedlist != properties->cache_used ) {
+			isla_destroy_path( *usedlist );
+		}
+		return ISLA_ERROR_BAD_ALLOC;
+	}
+	return ISLA_OK;
+}
+
+isla_status isla_search_begin( isla_search *search, isla_node *start, isla_node *finish, isla_properties *properties, void *userdata ) {
+	isla_status status;
+	isla_path *openlist;
+	isla_path *usedlist;
+
+	search->result.status = ISLA_ERROR_BAD_ARGUMENTS;
+	search->result.path = NULL;
+	search->on_complete = NULL;
+
+	if ( start == NULL || finish == NULL || properties == NULL ) {
+		return ISLA_ERROR_BAD_ARGUMENTS;
+	}
+
+	if ( isla__acquire_lists( properties, &openlist, &usedlist ) != ISLA_OK ) {
+		search->result.status = ISLA_ERROR_BAD_ALLOC;
+		return ISLA_ERROR_BAD_ALLOC;
+	}
+
+	start->g = 0;
+	start->f = properties->estimate_cost( start, finish, userdata );
+	start->parent = NULL;
+	start->status = ISLA_NODE_OPENED;
+
+	status = isla__path_push( usedlist, start );
+	if ( status == ISLA_OK ) {
+		status = isla__heap_enqueue( openlist, start );
+	}
+	if ( status != ISLA_OK ) {
+		start->status = ISLA_NODE_DEFAULT;
+		isla__cleanup( usedlist, openlist, properties );
+		search->result.status = status;
+		return status;
+	}
+
+	search->start = start;
+	search->finish = finish;
+	search->properties = properties;
+	search->userdata = userdata;
+	search->openlist = openlist;
+	search->usedlist = usedlist;
+	search->closest = start;
+	search->expansions = 0;
+	search->cancel_countdown = 1;
+	search->result.status = ISLA_IN_PROGRESS;
+	return ISLA_OK;
+}
+
+// Releases search lists and hands result over, completion callback takes ownership of the path
+static isla_result isla__search_finish( isla_search *search, isla_result result ) {
+	result = isla__backend_result( search->properties, result );
+	isla__cleanup( search->usedlist, search->openlist, search->properties );
+	search->result.status = result.status;
+	if ( search->on_complete != NULL ) {
+		search->on_complete( search, result, search->userdata );
+		result.path = NULL;
+	}
+	return result;
+}
+
+isla_result isla_search_step( isla_search *search, size_t max_expansions ) {
+	isla_properties *properties = search->properties;
+	isla_path *openlist = search->openlist;
+	isla_path *usedlist = search->usedlist;
+	isla_node *finish = search->finish;
+	void *userdata = search->userdata;
+	size_t steps = 0;
+	int limited = 0;
+	isla_result result = {ISLA_IN_PROGRESS,NULL};
+#ifdef ISLA_PREFETCH
+	isla__batch batch;
+#endif
+
+	if ( search->result.status != ISLA_IN_PROGRESS ) {
+		result.status = search->result.status;
+		return result;
+	}
+
+	while ( openlist->length > 0 && !limited ) {
+		isla_node *node;
+		isla_node *neighbor = NULL;
+		isla_status status;
+
+		if ( max_expansions > 0 && steps++ >= max_expansions ) {
+			return result;
+		}
+
+		status = isla__poll_cancel( properties, &search->cancel_countdown );
+		if ( status != ISLA_OK ) {
+			result.status = status;
+			return isla__search_finish( search, result );
+		}
+
+		node = isla__heap_dequeue( openlist );
+		node->status = ISLA_NODE_CLOSED;
+		ISLA__TRACE( properties, on_expand, node );
+
+		if ( isla__is_finish( node, finish, properties, userdata )) {
+			return isla__search_finish( search, isla__build_path( node ));
+		}
+
+		if ( isla__is_closer( node, search->closest, properties->partial )) {
+			search->closest = node;
+		}
+
+		search->expansions++;
+		if ( properties->max_expansions > 0 && search->expansions > properties->max_expansions ) {
+			limited = 1;
+			break;
+		}
+
+		while ( (neighbor = ISLA__NEXT_NEIGHBOR( node, neighbor ))) {
+			if ( (neighbor->status != ISLA_NODE_CLOSED || properties->reopen_closed) && (properties->prune_neighbor == NULL || !properties->prune_neighbor( node, neighbor, finish, userdata ))) {
+				isla_cost g = node->g + properties->eval_cost( node, neighbor, userdata );
+				if ( neighbor->status == ISLA_NODE_DEFAULT || g < neighbor->g ) {
+					if ( neighbor->status == ISLA_NODE_DEFAULT && !isla__within_memory( usedlist, openlist, properties->max_memory )) {
+						limited = 1;
+						break;
+					}
+					neighbor->g = g;
+					neighbor->f = g + properties->estimate_cost( neighbor, finish, userdata );
+					neighbor->parent = node;
+					if ( neighbor->status == ISLA_NODE_OPENED ) {
+						ISLA__TRACE( properties, on_update, neighbor );
+						isla__heap_update( openlist, neighbor );
+					} else if ( neighbor->status == ISLA_NODE_CLOSED ) {
+						// Inconsistent heuristic closed the node too early, it's already in used list
+						ISLA__TRACE( properties, on_update, neighbor );
+						neighbor->status = ISLA_NODE_OPENED;
+						result.status = isla__heap_enqueue( openlist, neighbor );
+						if ( result.status != ISLA_OK ) {
+							return isla__search_finish( search, result );
+						}
+						result.status = ISLA_IN_PROGRESS;
+					} else {
+						ISLA__TRACE( properties, on_generate, neighbor );
+						neighbor->status = ISLA_NODE_OPENED;
+						result.status = isla__path_push( usedlist, neighbor );
+						if ( result.status != ISLA_OK ) {
+							neighbor->status = ISLA_NODE_DEFAULT;
+							return isla__search_finish( search, result );
+						}
+						result.status = isla__heap_enqueue( openlist, neighbor );
+						if ( result.status != ISLA_OK ) {
+							return isla__search_finish( search, result );
+						}
+						result.status = ISLA_IN_PROGRESS;
+					}
+				}
+			}
+		}
+	}
+
+	if ( limited || properties->partial != ISLA_PARTIAL_NONE ) {
+		result = isla__build_path( search->closest );
+		if ( result.status == ISLA_OK ) {
+			result.status = limited ? ISLA_LIMIT_REACHED : ISLA_BLOCKED;
+		}
+	} else {
+		result.status = ISLA_BLOCKED;
+	}
+
+	return isla__search_finish( search, result );
+}
+
+void isla_search_abort( isla_search *search ) {
+	if ( search->result.status == ISLA_IN_PROGRESS ) {
+		isla_result result = {ISLA_CANCELLED,NULL};
+		isla__search_finish( search, result );
+	}
+}
+
+isla_result isla_find_path( isla_node *start, isla_node *finish, isla_properties *properties, void *userdata ) {
+	isla_search search;
+	isla_result result = {ISLA_OK,NULL};
+
+	result.status = isla_search_begin( &search, start, finish, properties, userdata );
+	if ( result.status != ISLA_OK ) {
+		return result;
+	}
+
+	return isla_search_step( &search, 0 );
+}
+
+
+// Dijkstra without heuristic and finish checks, nodes beyond the radius are never enqueued, so
+// the search stops by itself. Nodes are appended to the range when they are settled, i.e. in
+// the order of nondecreasing cost, range buffer is kept between calls.
+static isla_status isla__range_push( isla_range *range, isla_node *node ) {
+	if ( range->count >= range->allocated ) {
+		size_t newalloc = range->allocated > 0 ? range->allocated * 2 : ISLA_MAX_NEIGHBORS;
+		isla_reached *newreached = ISLA_REALLOC( range->reached, newalloc * sizeof( *range->reached ));
+		if ( newreached == NULL ) {
+			return ISLA_ERROR_BAD_REALLOC;
+		}
+		range->reached = newreached;
+		range->allocated = newalloc;
+	}
+	range->reached[range->count].node = node;
+	range->reached[range->count].cost = node->g;
+	range->count++;
+	return ISLA_OK;
+}
+
+isla_status isla_find_range( isla_node *start, isla_cost radius, isla_properties *properties, isla_range *range, void *userdata ) {
+	isla_status status;
+	isla_path *openlist;
+	isla_path *usedlist;
+	isla_node *node;
+	size_t cancel_countdown = 1;
+#ifdef ISLA_PREFETCH
+	isla__batch batch;
+#endif
+
+	if ( start == NULL || properties == NULL || range == NULL ) {
+		return ISLA_ERROR_BAD_ARGUMENTS;
+	}
+
+	range->count = 0;
+	status = isla__acquire_lists( properties, &openlist, &usedlist );
+	if ( status != ISLA_OK ) {
+		return status;
+	}
+
+	start->g = 0;
+	start->f = 0;
+	start->parent = NULL;
+	start->status = ISLA_NODE_OPENED;
+	status = isla__path_push( usedlist, start );
+	if ( status == ISLA_OK ) {
+		status = isla__heap_enqueue( openlist, start );
+	}
+
+	while ( status == ISLA_OK && (node = isla__heap_dequeue( openlist )) != NULL ) {
+		isla_node *neighbor = NULL;
+		status = isla__poll_cancel( properties, &cancel_countdown );
+		if ( status != ISLA_OK ) {
+			break;
+		}
+		node->status = ISLA_NODE_CLOSED;
+		ISLA__TRACE( properties, on_expand, node );
+		status = isla__range_push( range, node );
+		while ( status == ISLA_OK && (neighbor = ISLA__NEXT_NEIGHBOR( node, neighbor ))) {
+			if ( neighbor->status != ISLA_NODE_CLOSED ) {
+				isla_cost g = node->g + properties->eval_cost( node, neighbor, userdata );
+				if ( (radius < 0 || g <= radius) && (neighbor->status == ISLA_NODE_DEFAULT || g < neighbor->g) ) {
+					neighbor->g = g;
+					neighbor->f = g;
+					neighbor->parent = node;
+					if ( neighbor->status == ISLA_NODE_OPENED ) {
+						ISLA__TRACE( properties, on_update, neighbor );
+						isla__heap_update( openlist, neighbor );
+					} else {
+						ISLA__TRACE( properties, on_generate, neighbor );
+						neighbor->status = ISLA_NODE_OPENED;
+						status = isla__path_push( usedlist, neighbor );
+						if ( status == ISLA_OK ) {
+							status = isla__heap_enqueue( openlist, neighbor );
+						} else {
+							neighbor->status = ISLA_NODE_DEFAULT;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	isla__cleanup( usedlist, openlist, properties );
+	if ( status == ISLA_OK ) {
+		status = isla__backend_status( properties );
+	}
+	if ( status != ISLA_OK ) {
+		range->count = 0;
+	}
+	return status;
+}
+
+void isla_range_destroy( isla_range *range ) {
+	ISLA_FREE( range->reached );
+	range->reached = NULL;
+	range->count = 0;
+	range->allocated = 0;
+}
+
+
+#if defined(ISLA_TRACE) && !defined(ISLA_NO_STDIO)
+// Binary search trace: 20 bytes header (magic, version, stride, width, height), then 4 bytes
+// records of node index relative to the origin shifted left by 2 with event in the low bits.
+// All numbers are little-endian 32-bit.
+static void isla__tracer_u32( unsigned char *buffer, unsigned value ) {
+	buffer[0] = (unsigned char) (value & 0xff);
+	buffer[1] = (unsigned char) ((value >> 8) & 0xff);
+	buffer[2] = (unsigned char) ((value >> 16) & 0xff);
+	buffer[3] = (unsigned char) ((value >> 24) & 0xff);
+}
+
+static void isla__tracer_flush( isla_tracer *tracer ) {
+	if ( tracer->length > 0 && fwrite( tracer->buffer, 1, tracer->length, tracer->file ) != tracer->length ) {
+		tracer->status = ISLA_ERROR_IO;
+	}
+	tracer->length = 0;
+}
+
+static void isla__tracer_write( isla_tracer *tracer, unsigned value ) {
+	if ( tracer->length + 4 > ISLA_TRACE_BUFFER ) {
+		isla__tracer_flush( tracer );
+	}
+	isla__tracer_u32( tracer->buffer + tracer->length, value );
+	tracer->length += 4;
+	tracer->events++;
+}
+
+static void isla__tracer_event( isla_tracer *tracer, isla_node *node, isla_trace_event event ) {
+	isla__tracer_write( tracer, (unsigned) (node - tracer->origin) << 2 | (unsigned) event );
+}
+
+static void isla__tracer_expand( isla_node *node, void *data ) {
+	isla__tracer_event( data, node, ISLA_TRACE_EXPAND );
+}
+
+static void isla__tracer_generate( isla_node *node, void *data ) {
+	isla__tracer_event( data, node, ISLA_TRACE_GENERATE );
+}
+
+static void isla__tracer_update( isla_node *node, void *data ) {
+	isla__tracer_event( data, node, ISLA_TRACE_UPDATE );
+}
+
+isla_status isla_tracer_open( isla_tracer *tracer, const char *path, isla_node *origin, int stride, int width, int height ) {
+	unsigned header[5];
+	size_t i;
+	if ( path == NULL || origin == NULL || stride <= 0 || width <= 0 || height <= 0 ) {
+		return ISLA_ERROR_BAD_ARGUMENTS;
+	}
+	tracer->file = fopen( path, "wb" );
+	if ( tracer->file == NULL ) {
+		return ISLA_ERROR_IO;
+	}
+	tracer->origin = origin;
+	tracer->length = 0;
+	tracer->events = 0;
+	tracer->status = ISLA_OK;
+	header[0] = ISLA_TRACE_MAGIC;
+	header[1] = ISLA_TRACE_VERSION;
+	header[2] = (unsigned) stride;
+	header[3] = (unsigned) width;
+	header[4] = (unsigned) height;
+	for ( i = 0; i < 5; i++ ) {
+		isla__tracer_u32( tracer->buffer + tracer->length, header[i] );
+		tracer->length += 4;
+	}
+	return ISLA_OK;
+}
+
+// Marks are written between queries, so tools can tell them apart
+void isla_tracer_mark( isla_tracer *tracer, unsigned value ) {
+	isla__tracer_write( tracer, value << 2 | ISLA_TRACE_MARK );
+}
+
+void isla_tracer_properties( isla_tracer *tracer, isla_properties *properties ) {
+	properties->on_expand = isla__tracer_expand;
+	properties->on_generate = isla__tracer_generate;
+	properties->on_update = isla__tracer_update;
+	properties->trace_data = tracer;
+}
+
+isla_status isla_tracer_close( isla_tracer *tracer ) {
+	isla__tracer_flush( tracer );
+	if ( fclose( tracer->file ) != 0 ) {
+		tracer->status = ISLA_ERROR_IO;
+	}
+	tracer->file = NULL;
+	return tracer->status;
+}
+#endif
+// End of search tracing
+
+
+#ifdef ISLA_METRICS
+#ifndef ISLA__ATOMICS
+	#error "ISLA_METRICS needs GCC/Clang or MSVC atomics"
+#endif
+
+// Query metrics. Every thread writes only its own slots, so counters are updated by plain
+// relaxed load and store without read-modify-write, exporter sums slots of all threads.
+// Histograms are log-linear like HDR ones: values below 2^SUB_BITS are exact, above them
+// every power of two is split into 2^SUB_BITS buckets, so relative error is 2^-SUB_BITS.
+// Latency needs monotonic wall clock: wall time can be stepped by NTP and clock() sums CPU
+// time of all threads. clock() stays only as the last resort when neither is visible, e.g.
+// strict -std=c99 without _POSIX_C_SOURCE, ISLA_METRICS_CPU_CLOCK tells about it.
+#ifndef ISLA_METRICS_NOW
+	#if defined(_WIN32)
+		// Frequency is fixed at boot, it's queried once, racing threads store the same value
+		static unsigned long long isla__metrics_frequency = 0;
+
+		static unsigned long long isla__metrics_now( void ) {
+			LARGE_INTEGER counter;
+			unsigned long long frequency = ISLA__LOAD64( &isla__metrics_frequency );
+			if ( frequency == 0 ) {
+				LARGE_INTEGER queried;
+				QueryPerformanceFrequency( &queried );
+				frequency = (unsigned long long) queried.QuadPart;
+				ISLA__STORE64( &isla__metrics_frequency, frequency );
+			}
+			QueryPerformanceCounter( &counter );
+			return (unsigned long long) counter.QuadPart / frequency * 1000000000ull + (unsigned long long) counter.QuadPart % frequency * 1000000000ull / frequency;
+		}
+	#elif defined(CLOCK_MONOTONIC)
+		static unsigned long long isla__metrics_now( void ) {
+			struct timespec ts;
+			clock_gettime( CLOCK_MONOTONIC, &ts );
+			return (unsigned long long) ts.tv_sec * 1000000000ull + (unsigned long long) ts.tv_nsec;
+		}
+	#else
+		#define ISLA_METRICS_CPU_CLOCK
+		static unsigned long long isla__metrics_now( void ) {
+			return (unsigned long long) clock() * (1000000000ull / CLOCKS_PER_SEC);
+		}
+	#endif
+	#define ISLA_METRICS_NOW isla__metrics_now
+#endif
+
+typedef struct {
+	unsigned long long counts[ISLA_METRICS_BUCKETS];
+	unsigned long long total;
+	unsigned long long sum;
+	unsigned long long max;
+} isla__histogram;
+
+typedef struct {
+	isla__histogram histograms[3];
+	unsigned long long failures;
+} isla__metrics_slot;
+
+#define ISLA__METRICS_STRIDE ((sizeof( isla__metrics_slot ) + ISLA__CACHE_LINE - 1) / ISLA__CACHE_LINE * ISLA__CACHE_LINE)
+
+static isla__metrics_slot *isla__metrics_slot_at( const isla_metrics *metrics, size_t thread, size_t query_class ) {
+	return (isla__metrics_slot *) (metrics->slots + (thread * metrics->classes + query_class) * ISLA__METRICS_STRIDE);
+}
+
+static size_t isla__metrics_bucket( unsigned long long value ) {
+	int high = ISLA_METRICS_SUB_BITS;
+	if ( value >= 1ull << ISLA_METRICS_MAX_BITS ) {
+		value = (1ull << ISLA_METRICS_MAX_BITS) - 1;
+	}
+	if ( value < 1ull << ISLA_METRICS_SUB_BITS ) {
+		return (size_t) value;
+	}
+	while ( value >> (high + 1) ) {
+		high++;
+	}
+	return ((size_t) (high - ISLA_METRICS_SUB_BITS + 1) << ISLA_METRICS_SUB_BITS) + (size_t) (value >> (high - ISLA_METRICS_SUB_BITS)) - (1u << ISLA_METRICS_SUB_BITS);
+}
+
+// Highest value which falls into the bucket
+static unsigned long long isla__metrics_bucket_value( size_t bucket ) {
+	size_t block = bucket >> ISLA_METRICS_SUB_BITS;
+	unsigned long long sub = bucket & ((1u << ISLA_METRICS_SUB_BITS) - 1);
+	if ( block == 0 ) {
+		return sub;
+	}
+	return (((1ull << ISLA_METRICS_SUB_BITS) + sub + 1) << (block - 1)) - 1;
+}
+
+static void isla__histogram_add( isla__histogram *histogram, unsigned long long value ) {
+	unsigned long long *count = histogram->counts + isla__metrics_bucket( value );
+	ISLA__STORE64( count, ISLA__LOAD64( count ) + 1 );
+	ISLA__STORE64( &histogram->total, ISLA__LOAD64( &histogram->total ) + 1 );
+	ISLA__STORE64( &histogram->sum, ISLA__LOAD64( &histogram->sum ) + value );
+	if ( value > ISLA__LOAD64( &histogram->max )) {
+		ISLA__STORE64( &histogram->max, value );
+	}
+}
+
+isla_status isla_metrics_init( isla_metrics *metrics, size_t threads, size_t classes ) {
+	size_t i;
+	if ( threads == 0 || classes == 0 ) {
+		return ISLA_ERROR_BAD_ARGUMENTS;
+	}
+	metrics->slots = ISLA_MALLOC( threads * classes * ISLA__METRICS_STRIDE );
+	if ( metrics->slots == NULL ) {
+		return ISLA_ERROR_BAD_ALLOC;
+	}
+	for ( i = 0; i < threads * classes * ISLA__METRICS_STRIDE; i++ ) {
+		metrics->slots[i] = 0;
+	}
+	metrics->threads = threads;
+	metrics->classes = classes;
+	return ISLA_OK;
+}
+
+void isla_metrics_destroy( isla_metrics *metrics ) {
+	ISLA_FREE( metrics->slots );
+	metrics->slots = NULL;
+}
+
+// Must be called only from the thread which owns thread index, or under its lock
+void isla_metrics_record( isla_metrics *metrics, size_t thread, size_t query_class, isla_status status, unsigned long long latency_ns, size_t expansions, size_t length ) {
+	isla__metrics_slot *slot;
+	if ( thread >= metrics->threads || query_class >= metrics->classes ) {
+		return;
+	}
+	slot = isla__metrics_slot_at( metrics, thread, query_class );
+	isla__histogram_add( slot->histograms + ISLA_METRIC_LATENCY, latency_ns );
+	isla__histogram_add( slot->histograms + ISLA_METRIC_EXPANSIONS, expansions );
+	if ( status == ISLA_OK ) {
+		isla__histogram_add( slot->histograms + ISLA_METRIC_LENGTH, length );
+	} else {
+		ISLA__STORE64( &slot->failures, ISLA__LOAD64( &slot->failures ) + 1 );
+	}
+}
+
+isla_result isla_find_path_measured( isla_metrics *metrics, size_t thread, size_t query_class, isla_node *start, isla_node *finish, isla_properties *properties, void *userdata ) {
+	unsigned long long begin = ISLA_METRICS_NOW();
+	isla_search search;
+	isla_result result = {ISLA_OK,NULL};
+
+	search.expansions = 0;
+	result.status = isla_search_begin( &search, start, finish, properties, userdata );
+	if ( result.status == ISLA_OK ) {
+		result = isla_search_step( &search, 0 );
+	}
+	isla_metrics_record( metrics, thread, query_class, result.status, ISLA_METRICS_NOW() - begin, search.expansions, result.status == ISLA_OK ? result.path->length : 0 );
+	return result;
+}
+
+unsigned long long isla_metrics_count( const isla_metrics *metrics, size_t query_class, int failures ) {
+	unsigned long long count = 0;
+	size_t t;
+	for ( t = 0; t < metrics->threads && query_class < metrics->classes; t++ ) {
+		isla__metrics_slot *slot = isla__metrics_slot_at( metrics, t, query_class );
+		count += ISLA__LOAD64( failures ? &slot->failures : &slot->histograms[ISLA_METRIC_LATENCY].total );
+	}
+	return count;
+}
+
+static void isla__metrics_merge( const isla_metrics *metrics, size_t query_class, isla_metric metric, isla__histogram *merged ) {
+	size_t t;
+	size_t i;
+	for ( i = 0; i < ISLA_METRICS_BUCKETS; i++ ) {
+		merged->counts[i] = 0;
+	}
+	merged->total = 0;
+	merged->sum = 0;
+	merged->max = 0;
+	for ( t = 0; t < metrics->threads; t++ ) {
+		isla__histogram *histogram = isla__metrics_slot_at( metrics, t, query_class )->histograms + metric;
+		unsigned long long max = ISLA__LOAD64( &histogram->max );
+		for ( i = 0; i < ISLA_METRICS_BUCKETS; i++ ) {
+			merged->counts[i] += ISLA__LOAD64( histogram->counts + i );
+		}
+		merged->total += ISLA__LOAD64( &histogram->total );
+		merged->sum += ISLA__LOAD64( &histogram->sum );
+		merged->max = max > merged->max ? max : merged->max;
+	}
+}
+
+static unsigned long long isla__histogram_percentile( const isla__histogram *histogram, double percentile ) {
+	unsigned long long seen = 0;
+	unsigned long long rank;
+	size_t i;
+	if ( histogram->total == 0 ) {
+		return 0;
+	}
+	rank = (unsigned long long) (percentile / 100.0 * (double) histogram->total + 0.5);
+	rank = rank < 1 ? 1 : rank > histogram->total ? histogram->total : rank;
+	for ( i = 0; i < ISLA_METRICS_BUCKETS; i++ ) {
+		seen += histogram->counts[i];
+		if ( seen >= rank ) {
+			unsigned long long value = isla__metrics_bucket_value( i );
+			return value < histogram->max ? value : histogram->max;
+		}
+	}
+	return histogram->max;
+}
+
+// Percentile is from 0 to 100, reads are racy but every counter is read atomically
+unsigned long long isla_metrics_percentile( const isla_metrics *metrics, size_t query_class, isla_metric metric, double percentile ) {
+	isla__histogram *merged;
+	unsigned long long value;
+	if ( query_class >= metrics->classes || (merged = ISLA_MALLOC( sizeof( *merged ))) == NULL ) {
+		return 0;
+	}
+	isla__metrics_merge( metrics, query_class, metric, merged );
+	value = isla__histogram_percentile( merged, percentile );
+	ISLA_FREE( merged );
+	return value;
+}
+
+#ifndef ISLA_NO_STDIO
+static const double isla__metrics_quantiles[] = {50, 90, 99, 99.9};
+
+static const char *isla__metrics_label( const char *const *class_names, size_t query_class, char *number ) {
+	if ( class_names != NULL ) {
+		return class_names[query_class];
+	}
+	sprintf( number, "%lu", (unsigned long) query_class );
+	return number;
+}
+
+// Snapshot is written to path.tmp and renamed, so scrapers never see partial file
+isla_status isla_metrics_export( const isla_metrics *metrics, const char *path, const char *const *class_names, isla_metrics_format format ) {
+	static const char *names[3] = {"isla_query_latency_seconds", "isla_query_expansions", "isla_query_path_length"};
+	static const char *text_names[3] = {"latency_us", "expansions", "length"};
+	isla__histogram *merged = ISLA_MALLOC( sizeof( *merged ));
+	char *tmp = NULL;
+	size_t path_length = 0;
+	FILE *file = NULL;
+	isla_status status = ISLA_OK;
+	char number[24];
+	size_t c, q;
+	int m;
+
+	if ( merged == NULL || path == NULL ) {
+		ISLA_FREE( merged );
+		return path == NULL ? ISLA_ERROR_BAD_ARGUMENTS : ISLA_ERROR_BAD_ALLOC;
+	}
+	while ( path[path_length] != '\0' ) {
+		path_length++;
+	}
+	tmp = ISLA_MALLOC( path_length + 5 );
+	if ( tmp == NULL ) {
+		ISLA_FREE( merged );
+		return ISLA_ERROR_BAD_ALLOC;
+	}
+	sprintf( tmp, "%s.tmp", path );
+	file = fopen( tmp, "w" );
+	if ( file == NULL ) {
+		ISLA_FREE( merged );
+		ISLA_FREE( tmp );
+		return ISLA_ERROR_IO;
+	}
+
+	if ( format == ISLA_METRICS_PROMETHEUS ) {
+		for ( m = 0; m < 3; m++ ) {
+			fprintf( file, "# TYPE %s summary\n", names[m] );
+			for ( c = 0; c < metrics->classes; c++ ) {
+				double scale = m == ISLA_METRIC_LATENCY ? 1e-9 : 1;
+				const char *label = isla__metrics_label( class_names, c, number );
+				isla__metrics_merge( metrics, c, (isla_metric) m, merged );
+				for ( q = 0; q < sizeof( isla__metrics_quantiles ) / sizeof( *isla__metrics_quantiles ); q++ ) {
+					fprintf( file, "%s{class=\"%s\",quantile=\"%g\"} %.9g\n", names[m], label, isla__metrics_quantiles[q] / 100, scale * (double) isla__histogram_percentile( merged, isla__metrics_quantiles[q] ));
+				}
+				fprintf( file, "%s_sum{class=\"%s\"} %.9g\n", names[m], label, scale * (double) merged->sum );
+				fprintf( file, "%s_count{class=\"%s\"} %llu\n", names[m], label, merged->total );
+			}
+		}
+		fprintf( file, "# TYPE isla_query_failures_total counter\n" );
+		for ( c = 0; c < metrics->classes; c++ ) {
+			fprintf( file, "isla_query_failures_total{class=\"%s\"} %llu\n", isla__metrics_label( class_names, c, number ), isla_metrics_count( metrics, c, 1 ));
+		}
+	} else {
+		for ( c = 0; c < metrics->classes; c++ ) {
+			fprintf( file, "%s count %llu failures %llu", isla__metrics_label( class_names, c, number ), isla_metrics_count( metrics, c, 0 ), isla_metrics_count( metrics, c, 1 ));
+			for ( m = 0; m < 3; m++ ) {
+				double scale = m == ISLA_METRIC_LATENCY ? 1e-3 : 1;
+				isla__metrics_merge( metrics, c, (isla_metric) m, merged );
+				fprintf( file, " %s", text_names[m] );
+				for ( q = 0; q < sizeof( isla__metrics_quantiles ) / sizeof( *isla__metrics_quantiles ); q++ ) {
+					fprintf( file, " p%g %.6g", isla__metrics_quantiles[q], scale * (double) isla__histogram_percentile( merged, isla__metrics_quantiles[q] ));
+				}
+				fprintf( file, " max %.6g", scale * (double) merged->max );
+			}
+			fprintf( file, "\n" );
+		}
+	}
+
+	if ( ferror( file )) {
+		status = ISLA_ERROR_IO;
+	}
+	if ( fclose( file ) != 0 ) {
+		status = ISLA_ERROR_IO;
+	}
+	if ( status == ISLA_OK && rename( tmp, path ) != 0 ) {
+		status = ISLA_ERROR_IO;
+	}
+	if ( status != ISLA_OK ) {
+		remove( tmp );
+	}
+	ISLA_FREE( merged );
+	ISLA_FREE( tmp );
+	return status;
+}
+#endif
+#endif
+// End of query metrics
+
+
+#ifndef ISLA_NO_STDIO
+// Replay recorder. Nodes get sequential ids when they are seen first, and every query logs
+// what the search observed, so it can be rerun offline without the original graph state.
+// File is 8 bytes header (magic, version) followed by records of one tag byte and fields,
+// ids and counts are little-endian 32-bit, costs are little-endian IEEE doubles:
+//   'Q' start finish                   - query begins
+//   'N' node count (neighbor cost)*    - all neighbors left after pruning, with costs
+//   'H' node target estimate           - heuristic value, once per node and target finish
+//   'F' node                           - is_finish_node returned true
+//   'E' status length node*            - query ended, path nodes as returned (reversed)
+// Neighbors are listed all at once when node is expanded the first time in a query, so any
+// search over the same nodes can be replayed.
+static void isla__recorder_put_u32( unsigned char *buffer, unsigned value ) {
+	buffer[0] = (unsigned char) (value & 0xff);
+	buffer[1] = (unsigned char) ((value >> 8) & 0xff);
+	buffer[2] = (unsigned char) ((value >> 16) & 0xff);
+	buffer[3] = (unsigned char) ((value >> 24) & 0xff);
+}
+
+static void isla__recorder_put_cost( unsigned char *buffer, isla_cost cost ) {
+	union {
+		double d;
+		unsigned long long u;
+	} bits;
+	int i;
+	// Double is assumed to be IEEE 754 with the same byte order as integers
+	bits.d = (double) cost;
+	for ( i = 0; i < 8; i++ ) {
+		buffer[i] = (unsigned char) ((bits.u >> (8 * i)) & 0xff);
+	}
+}
+
+static void isla__recorder_write( isla_recorder *recorder, const void *data, size_t size ) {
+	if ( recorder->status == ISLA_OK && fwrite( data, 1, size, recorder->file ) != size ) {
+		recorder->status = ISLA_ERROR_IO;
+	}
+}
+
+static unsigned isla__recorder_id( isla_recorder *recorder, isla_node *node ) {
+	size_t *id = isla__map_get( &recorder->ids, (size_t) node );
+	if ( id != NULL ) {
+		return (unsigned) *id;
+	}
+	if ( isla__map_put( &recorder->ids, (size_t) node, recorder->next_id ) != ISLA_OK ) {
+		recorder->status = ISLA_ERROR_BAD_ALLOC;
+	}
+	return recorder->next_id++;
+}
+
+static void isla__recorder_record( isla_recorder *recorder, unsigned char tag, unsigned a, unsigned b ) {
+	unsigned char record[9];
+	record[0] = tag;
+	isla__recorder_put_u32( record + 1, a );
+	isla__recorder_put_u32( record + 5, b );
+	isla__recorder_write( recorder, record, tag == 'F' ? 5 : 9 );
+}
+
+isla_status isla_recorder_open( isla_recorder *recorder, const char *path, isla_properties *properties, void *userdata ) {
+	unsigned char header[8];
+	if ( path == NULL || properties == NULL ) {
+		return ISLA_ERROR_BAD_ARGUMENTS;
+	}
+	recorder->scratch = NULL;
+	recorder->scratch_size = 0;
+	if ( isla__map_init( &recorder->ids, 1024 ) != ISLA_OK ) {
+		return ISLA_ERROR_BAD_ALLOC;
+	}
+	if ( isla__map_init( &recorder->expanded, 256 ) != ISLA_OK ) {
+		isla__map_destroy( &recorder->ids );
+		return ISLA_ERROR_BAD_ALLOC;
+	}
+	if ( isla__map_init( &recorder->estimated, 256 ) != ISLA_OK ) {
+		isla__map_destroy( &recorder->ids );
+		isla__map_destroy( &recorder->expanded );
+		return ISLA_ERROR_BAD_ALLOC;
+	}
+	recorder->file = fopen( path, "wb" );
+	if ( recorder->file == NULL ) {
+		isla__map_destroy( &recorder->ids );
+		isla__map_destroy( &recorder->expanded );
+		isla__map_destroy( &recorder->estimated );
+		return ISLA_ERROR_IO;
+	}
+	recorder->finish = NULL;
+	recorder->next_id = 0;
+	recorder->queries = 0;
+	recorder->status = ISLA_OK;
+	recorder->next_neighbor = properties->next_neighbor;
+	recorder->eval_cost = properties->eval_cost;
+	recorder->estimate_cost = properties->estimate_cost;
+	recorder->is_finish_node = properties->is_finish_node;
+	recorder->prune_neighbor = properties->prune_neighbor;
+	recorder->userdata = userdata;
+	isla__recorder_put_u32( header, ISLA_REPLAY_MAGIC );
+	isla__recorder_put_u32( header + 4, ISLA_REPLAY_VERSION );
+	isla__recorder_write( recorder, header, sizeof( header ));
+	return recorder->status;
+}
+
+void isla_recorder_properties( isla_recorder *recorder, isla_properties *properties ) {
+	properties->next_neighbor = isla_recorder_next_neighbor;
+	properties->eval_cost = isla_recorder_eval_cost;
+	properties->estimate_cost = isla_recorder_estimate_cost;
+	properties->is_finish_node = recorder->is_finish_node != NULL ? isla_recorder_is_finish_node : NULL;
+	properties->prune_neighbor = recorder->prune_neighbor != NULL ? isla_recorder_prune : NULL;
+}
+
+void isla_recorder_begin( isla_recorder *recorder, isla_node *start, isla_node *finish ) {
+	unsigned a = isla__recorder_id( recorder, start );
+	unsigned b = isla__recorder_id( recorder, finish );
+	isla__map_clear( &recorder->expanded );
+	isla__map_clear( &recorder->estimated );
+	recorder->finish = finish;
+	recorder->queries++;
+	isla__recorder_record( recorder, 'Q', a, b );
+}
+
+void isla_recorder_end( isla_recorder *recorder, const isla_result *result ) {
+	size_t length = result->path != NULL ? result->path->length : 0;
+	size_t i;
+	unsigned char id[4];
+	isla__recorder_record( recorder, 'E', (unsigned) result->status, (unsigned) length );
+	for ( i = 0; i < length; i++ ) {
+		isla__recorder_put_u32( id, isla__recorder_id( recorder, result->path->nodes[i] ));
+		isla__recorder_write( recorder, id, 4 );
+	}
+	recorder->finish = NULL;
+}
+
+isla_result isla_find_path_recorded( isla_recorder *recorder, isla_node *start, isla_node *finish, isla_properties *properties ) {
+	isla_result result;
+	isla_recorder_begin( recorder, start, finish );
+	result = isla_find_path( start, finish, properties, recorder );
+	isla_recorder_end( recorder, &result );
+	return result;
+}
+
+isla_status isla_recorder_close( isla_recorder *recorder ) {
+	if ( fclose( recorder->file ) != 0 && recorder->status == ISLA_OK ) {
+		recorder->status = ISLA_ERROR_IO;
+	}
+	recorder->file = NULL;
+	isla__map_destroy( &recorder->ids );
+	isla__map_destroy( &recorder->expanded );
+	isla__map_destroy( &recorder->estimated );
+	ISLA_FREE( recorder->scratch );
+	recorder->scratch = NULL;
+	return recorder->status;
+}
+
+// First call for a node in the query logs its whole neighborhood
+static void isla__recorder_expand( isla_recorder *recorder, isla_node *node ) {
+	isla_node *neighbor = NULL;
+	size_t size = 9;
+	if ( isla__map_put( &recorder->expanded, (size_t) node, 1 ) != ISLA_OK ) {
+		recorder->status = ISLA_ERROR_BAD_ALLOC;
+		return;
+	}
+	recorder->scratch[0] = 'N';
+	isla__recorder_put_u32( recorder->scratch + 1, isla__recorder_id( recorder, node ));
+	while ( (neighbor = recorder->next_neighbor( node, neighbor, recorder->userdata ))) {
+		if ( recorder->prune_neighbor != NULL && recorder->prune_neighbor( node, neighbor, recorder->finish, recorder->userdata )) {
+			continue;
+		}
+		if ( size + 12 > recorder->scratch_size ) {
+			unsigned char *scratch = ISLA_REALLOC( recorder->scratch, recorder->scratch_size * 2 );
+			if ( scratch == NULL ) {
+				recorder->status = ISLA_ERROR_BAD_REALLOC;
+				return;
+			}
+			recorder->scratch = scratch;
+			recorder->scratch_size *= 2;
+		}
+		isla__recorder_put_u32( recorder->scratch + size, isla__recorder_id( recorder, neighbor ));
+		isla__recorder_put_cost( recorder->scratch + size + 4, recorder->eval_cost( node, neighbor, recorder->userdata ));
+		size += 12;
+	}
+	isla__recorder_put_u32( recorder->scratch + 5, (unsigned) ((size - 9) / 12));
+	isla__recorder_write( recorder, recorder->scratch, size );
+}
+
+isla_node *isla_recorder_next_neighbor( isla_node *node, isla_node *prev, void *userdata ) {
+	isla_recorder *recorder = userdata;
+	if ( prev == NULL && recorder->status == ISLA_OK && isla__map_get( &recorder->expanded, (size_t) node ) == NULL ) {
+		if ( recorder->scratch == NULL ) {
+			recorder->scratch_size = 9 + 12 * ISLA_MAX_NEIGHBORS;
+			recorder->scratch = ISLA_MALLOC( recorder->scratch_size );
+		}
+		if ( recorder->scratch == NULL ) {
+			recorder->status = ISLA_ERROR_BAD_ALLOC;
+		} else {
+			isla__recorder_expand( recorder, node );
+		}
+	}
+	return recorder->next_neighbor( node, prev, recorder->userdata );
+}
+
+isla_cost isla_recorder_eval_cost( isla_node *node1, isla_node *node2, void *userdata ) {
+	isla_recorder *recorder = userdata;
+	return recorder->eval_cost( node1, node2, recorder->userdata );
+}
+
+isla_cost isla_recorder_estimate_cost( isla_node *node1, isla_node *node2, void *userdata ) {
+	isla_recorder *recorder = userdata;
+	isla_cost estimate = recorder->estimate_cost( node1, node2, recorder->userdata );
+	if ( node2 != recorder->finish || isla__map_get( &recorder->estimated, (size_t) node1 ) == NULL ) {
+		unsigned char record[17];
+		record[0] = 'H';
+		isla__recorder_put_u32( record + 1, isla__recorder_id( recorder, node1 ));
+		isla__recorder_put_u32( record + 5, isla__recorder_id( recorder, node2 ));
+		isla__recorder_put_cost( record + 9, estimate );
+		isla__recorder_write( recorder, record, sizeof( record ));
+		if ( node2 == recorder->finish && isla__map_put( &recorder->estimated, (size_t) node1, 1 ) != ISLA_OK ) {
+			recorder->status = ISLA_ERROR_BAD_ALLOC;
+		}
+	}
+	return estimate;
+}
+
+int isla_recorder_is_finish_node( isla_node *node, void *userdata ) {
+	isla_recorder *recorder = userdata;
+	int finish = recorder->is_finish_node( node, recorder->userdata );
+	if ( finish ) {
+		isla__recorder_record( recorder, 'F', isla__recorder_id( recorder, node ), 0 );
+	}
+	return finish;
+}
+
+int isla_recorder_prune( isla_node *node, isla_node *neighbor, isla_node *finish, void *userdata ) {
+	isla_recorder *recorder = userdata;
+	return recorder->prune_neighbor( node, neighbor, finish, recorder->userdata );
+}
+#endif
+// End of replay recorder
+
+
+// Alternative routes by penalty method. After every search costs of edges leading to the nodes
+// of the found path are increased, so the next search prefers other routes. Paths which share
+// too many nodes with already accepted ones are rejected. All searches reuse one workspace.
+typedef struct {
+	isla_properties *properties;
+	void *userdata;
+	isla__map uses;
+	isla__map marks;
+	isla_cost penalty;
+} isla__alt;
+
+static isla_node *isla__alt_next_neighbor( isla_node *node, isla_node *prev, void *userdata ) {
+	isla__alt *alt = userdata;
+	return alt->properties->next_neighbor( node, prev, alt->userdata );
+}
+
+static isla_cost isla__alt_eval_cost( isla_node *node1, isla_node *node2, void *userdata ) {
+	isla__alt *alt = userdata;
+	isla_cost cost = alt->properties->eval_cost( node1, node2, alt->userdata );
+	size_t *uses = isla__map_get( &alt->uses, (size_t) node2 );
+	return uses != NULL ? cost + cost * alt->penalty * (isla_cost) *uses : cost;
+}
+
+static isla_cost isla__alt_estimate_cost( isla_node *node1, isla_node *node2, void *userdata ) {
+	isla__alt *alt = userdata;
+	return alt->properties->estimate_cost( node1, node2, alt->userdata );
+}
+
+static int isla__alt_is_finish_node( isla_node *node, void *userdata ) {
+	isla__alt *alt = userdata;
+	return alt->properties->is_finish_node( node, alt->userdata );
+}
+
+static int isla__alt_prune( isla_node *node, isla_node *neighbor, isla_node *finish, void *userdata ) {
+	isla__alt *alt = userdata;
+	return alt->properties->prune_neighbor( node, neighbor, finish, alt->userdata );
+}
+
+// Inner nodes of the found path are marked with the attempt number, so overlap with every
+// accepted path is counted in one pass over it
+static isla_status isla__alt_mark( isla__alt *alt, isla_path *path, size_t attempt ) {
+	size_t i;
+	for ( i = 1; i + 1 < path->length; i++ ) {
+		if ( isla__map_put( &alt->marks, (size_t) path->nodes[i], attempt ) != ISLA_OK ) {
+			return ISLA_ERROR_BAD_ALLOC;
+		}
+	}
+	return ISLA_OK;
+}
+
+// Share of inner nodes of the marked path which are used by the accepted path, identical
+// short paths have no inner nodes and are treated as full overlap
+static double isla__alt_overlap( isla__alt *alt, isla_path *path, isla_path *accepted, size_t attempt ) {
+	size_t shared = 0;
+	size_t j;
+	if ( path->length <= 2 ) {
+		return 1.0;
+	}
+	for ( j = 1; j + 1 < accepted->length; j++ ) {
+		size_t *mark = isla__map_get( &alt->marks, (size_t) accepted->nodes[j] );
+		if ( mark != NULL && *mark == attempt ) {
+			shared++;
+		}
+	}
+	return (double) shared / (double) (path->length - 2);
+}
+
+size_t isla_find_path_alternatives( isla_node *start, isla_node *finish, isla_properties *properties, isla_alternatives *alternatives, isla_result *results, void *userdata ) {
+	isla_properties local;
+	isla_workspace workspace;
+	isla__alt alt;
+	size_t found = 0;
+	size_t max_attempts;
+
+	results[0].status = ISLA_ERROR_BAD_ARGUMENTS;
+	results[0].path = NULL;
+	if ( start == NULL || finish == NULL || properties == NULL || alternatives == NULL || alternatives->count == 0 ) {
+		return 0;
+	}
+
+	alt.properties = properties;
+	alt.userdata = userdata;
+	alt.penalty = alternatives->penalty;
+	local = *properties;
+	local.next_neighbor = isla__alt_next_neighbor;
+	local.eval_cost = isla__alt_eval_cost;
+	local.estimate_cost = isla__alt_estimate_cost;
+	local.is_finish_node = properties->is_finish_node != NULL ? isla__alt_is_finish_node : NULL;
+	local.prune_neighbor = properties->prune_neighbor != NULL ? isla__alt_prune : NULL;
+	local.partial = ISLA_PARTIAL_NONE;
+	if ( local.workspace == NULL ) {
+		if ( isla_workspace_init( &workspace, 0, 0 ) != ISLA_OK ) {
+			results[0].status = ISLA_ERROR_BAD_ALLOC;
+			return 0;
+		}
+		local.workspace = &workspace;
+	}
+	alt.marks.entries = NULL;
+	if ( isla__map_init( &alt.uses, 64 ) != ISLA_OK || isla__map_init( &alt.marks, 64 ) != ISLA_OK ) {
+		isla__map_destroy( &alt.uses );
+		if ( properties->workspace == NULL ) {
+			isla_workspace_destroy( &workspace );
+		}
+		results[0].status = ISLA_ERROR_BAD_ALLOC;
+		return 0;
+	}
+
+	max_attempts = alternatives->max_attempts > 0 ? alternatives->max_attempts : alternatives->count * 3;
+	alternatives->attempts = 0;
+	while ( found < alternatives->count && alternatives->attempts < max_attempts ) {
+		isla_result result = isla_find_path( start, finish, &local, &alt );
+		isla_status status = ISLA_OK;
+		int accepted = 1;
+		size_t i;
+		alternatives->attempts++;
+		if ( result.status != ISLA_OK ) {
+			// Limited search carries partial path, failed status is reported without it
+			isla_destroy_path( result.path );
+			if ( found == 0 ) {
+				results[0].status = result.status;
+			}
+			break;
+		}
+		if ( found > 0 && isla__alt_mark( &alt, result.path, alternatives->attempts ) != ISLA_OK ) {
+			status = ISLA_ERROR_BAD_ALLOC;
+		}
+		for ( i = 0; i < found && accepted && status == ISLA_OK; i++ ) {
+			accepted = isla__alt_overlap( &alt, result.path, results[i].path, alternatives->attempts ) <= alternatives->max_overlap;
+		}
+		// Rejected paths are penalized too, otherwise the next search would return them again
+		for ( i = 0; i < result.path->length && status == ISLA_OK; i++ ) {
+			size_t *uses = isla__map_get( &alt.uses, (size_t) result.path->nodes[i] );
+			if ( uses != NULL ) {
+				(*uses)++;
+			} else if ( isla__map_put( &alt.uses, (size_t) result.path->nodes[i], 1 ) != ISLA_OK ) {
+				status = ISLA_ERROR_BAD_ALLOC;
+			}
+		}
+		if ( status != ISLA_OK ) {
+			// Path which couldn't be marked or penalized is dropped and the search stops
+			isla_destroy_path( result.path );
+			if ( found == 0 ) {
+				results[0].status = status;
+			}
+			break;
+		}
+		if ( accepted ) {
+			results[found++] = result;
+		} else {
+			isla_destroy_path( result.path );
+		}
+	}
+
+	isla__map_destroy( &alt.uses );
+	isla__map_destroy( &alt.marks );
+	if ( properties->workspace == NULL ) {
+		isla_workspace_destroy( &workspace );
+	}
+	return found;
+}
+// End of alternative routes
+
+
+// Iterative deepening A*, memory is bounded by max_depth frames and fixed size transposition table
+typedef struct {
+	isla_node *node;
+	isla_node *neighbor;
+} isla__ida_frame;
+
+typedef struct {
+	isla_node *node;
+	isla_cost g;
+	size_t iteration;
+} isla__ida_entry;
+
+isla_result isla_find_path_ida( isla_node *start, isla_node *finish, isla_properties *properties, size_t max_depth, size_t table_size, void *userdata ) {
+	isla_result result = {ISLA_OK,NULL};
+	isla__ida_frame *frames;
+	isla__ida_entry *table = NULL;
+	isla_cost threshold;
+	size_t iteration = 0;
+	int limited = 0;
+	int done = 0;
+
+	if ( start == NULL || finish == NULL || properties == NULL || max_depth == 0 ) {
+		result.status = ISLA_ERROR_BAD_ARGUMENTS;
+		return result;
+	}
+
+	frames = ISLA_MALLOC( max_depth * sizeof( *frames ));
+	if ( frames == NULL ) {
+		result.status = ISLA_ERROR_BAD_ALLOC;
+		return result;
+	}
+
+	// Transposition table is optional, without it search is slower but still correct
+	if ( table_size > 0 ) {
+		table = ISLA_MALLOC( table_size * sizeof( *table ));
+		if ( table != NULL ) {
+			size_t i;
+			for ( i = 0; i < table_size; i++ ) {
+				table[i].node = NULL;
+			}
+		}
+	}
+
+	threshold = properties->estimate_cost( start, finish, userdata );
+
+	if ( isla__is_finish( start, finish, properties, userdata )) {
+		result = isla__build_path( start );
+		done = 1;
+	}
+
+	while ( !done ) {
+		isla_cost next = threshold;
+		int has_next = 0;
+		size_t depth = 1;
+
+		iteration++;
+		start->status = ISLA_NODE_OPENED;
+		frames[0].node = start;
+		frames[0].neighbor = NULL;
+
+		while ( depth > 0 ) {
+			isla__ida_frame *frame = frames + depth - 1;
+			isla_node *node = frame->node;
+			isla_node *neighbor = properties->next_neighbor( node, frame->neighbor, userdata );
+			isla_cost g;
+			isla_cost f;
+
+			frame->neighbor = neighbor;
+			if ( neighbor == NULL ) {
+				isla__reset_node( node );
+				depth--;
+				continue;
+			}
+
+			// Nodes on the current path are marked as opened, this prevents cycles
+			if ( neighbor->status == ISLA_NODE_OPENED ) {
+				continue;
+			}
+
+			g = node->g + properties->eval_cost( node, neighbor, userdata );
+			f = g + properties->estimate_cost( neighbor, finish, userdata );
+			if ( f > threshold ) {
+				if ( !has_next || f < next ) {
+					next = f;
+					has_next = 1;
+				}
+				continue;
+			}
+
+			if ( table != NULL ) {
+				isla__ida_entry *entry = table + isla__hash( (size_t) neighbor ) % table_size;
+				if ( entry->node == neighbor && entry->iteration == iteration && entry->g <= g ) {
+					continue;
+				}
+				entry->node = neighbor;
+				entry->g = g;
+				entry->iteration = iteration;
+			}
+
+			neighbor->g = g;
+			neighbor->f = f;
+			neighbor->parent = node;
+
+			if ( isla__is_finish( neighbor, finish, properties, userdata )) {
+				result = isla__build_path( neighbor );
+				isla__reset_node( neighbor );
+				while ( depth > 0 ) {
+					isla__reset_node( frames[--depth].node );
+				}
+				done = 1;
+				break;
+			}
+
+			if ( depth >= max_depth ) {
+				isla__reset_node( neighbor );
+				limited = 1;
+				continue;
+			}
+
+			neighbor->status = ISLA_NODE_OPENED;
+			frames[depth].node = neighbor;
+			frames[depth].neighbor = NULL;
+			depth++;
+		}
+
+		if ( !done ) {
+			if ( !has_next ) {
+				result.status = limited ? ISLA_LIMIT_REACHED : ISLA_BLOCKED;
+				done = 1;
+			}
+			threshold = next;
+		}
+	}
+
+	ISLA_FREE( table );
+	ISLA_FREE( frames );
+
+	return isla__backend_result( properties, result );
+}
+// End of iterative deepening A*
+
+
+// Simplified memory-bounded A*, at most max_nodes are kept in memory. When budget is exhausted
+// the worst open leaf is dropped and its f is remembered by the parent, parent is reopened
+// when all of its children were forgotten. Open leaves are also kept in a max-heap on f, so
+// the worst one is found in O(1) and removed in O(log n) instead of scanning the open list.
+typedef struct {
+	isla_node *node;
+	size_t children;
+	size_t worst;
+	isla_cost forgotten;
+	int has_forgotten;
+} isla__sma_slot;
+
+typedef struct {
+	isla_path open;
+	isla__sma_slot *slots;
+	size_t *free;
+	size_t nfree;
+	size_t *worst;
+	size_t worst_length;
+	isla__map map;
+	isla_node *expanding;
+} isla__sma;
+
+static size_t isla__sma_index_of( isla__sma *sma, isla_node *node ) {
+	return *isla__map_get( &sma->map, (size_t) node );
+}
+
+static isla__sma_slot *isla__sma_slot_of( isla__sma *sma, isla_node *node ) {
+	return sma->slots + isla__sma_index_of( sma, node );
+}
+
+// Max-heap of slot indices of open leaves
+static isla_cost isla__sma_worst_f( isla__sma *sma, size_t position ) {
+	return sma->slots[sma->worst[position]].node->f;
+}
+
+static void isla__sma_worst_swap( isla__sma *sma, size_t position1, size_t position2 ) {
+	size_t tmp = sma->worst[position1];
+	sma->worst[position1] = sma->worst[position2];
+	sma->worst[position2] = tmp;
+	sma->slots[sma->worst[position1]].worst = position1;
+	sma->slots[sma->worst[position2]].worst = position2;
+}
+
+static void isla__sma_worst_siftup( isla__sma *sma, size_t position ) {
+	while ( position > 0 && isla__sma_worst_f( sma, (position-1) >> 1 ) < isla__sma_worst_f( sma, position )) {
+		isla__sma_worst_swap( sma, position, (position-1) >> 1 );
+		position = (position-1) >> 1;
+	}
+}
+
+static void isla__sma_worst_siftdown( isla__sma *sma, size_t position ) {
+	size_t left = (position << 1) + 1;
+	while ( left < sma->worst_length ) {
+		size_t higher = ( left + 1 < sma->worst_length && isla__sma_worst_f( sma, left ) < isla__sma_worst_f( sma, left + 1 )) ? left + 1 : left;
+		if ( !(isla__sma_worst_f( sma, position ) < isla__sma_worst_f( sma, higher )))
+			break;
+		isla__sma_worst_swap( sma, position, higher );
+		position = higher;
+		left = (position << 1) + 1;
+	}
+}
+
+static void isla__sma_push_open( isla__sma *sma, size_t index ) {
+	isla__heap_enqueue( &sma->open, sma->slots[index].node );
+	sma->worst[sma->worst_length] = index;
+	sma->slots[index].worst = sma->worst_length++;
+	isla__sma_worst_siftup( sma, sma->slots[index].worst );
+}
+
+// Drops the node from the worst heap, the open list is updated by the caller
+static void isla__sma_forget_open( isla__sma *sma, size_t index ) {
+	size_t position = sma->slots[index].worst;
+	if ( position < --sma->worst_length ) {
+		isla__sma_worst_swap( sma, position, sma->worst_length );
+		isla__sma_worst_siftup( sma, position );
+		isla__sma_worst_siftdown( sma, position );
+	}
+}
+
+static void isla__sma_add( isla__sma *sma, isla_node *node, isla_node *parent, isla_cost g, isla_cost f ) {
+	size_t index = sma->free[--sma->nfree];
+	isla__sma_slot *slot = sma->slots + index;
+	slot->node = node;
+	slot->children = 0;
+	slot->has_forgotten = 0;
+	isla__map_put( &sma->map, (size_t) node, index );
+	node->g = g;
+	node->f = f;
+	node->parent = parent;
+	node->status = ISLA_NODE_OPENED;
+	isla__sma_push_open( sma, index );
+	if ( parent != NULL ) {
+		isla__sma_slot_of( sma, parent )->children++;
+	}
+}
+
+static void isla__sma_remember( isla__sma_slot *slot, isla_cost f ) {
+	if ( !slot->has_forgotten || f < slot->forgotten ) {
+		slot->forgotten = f;
+		slot->has_forgotten = 1;
+	}
+}
+
+static void isla__sma_release( isla__sma *sma, isla_node *node, int dead );
+
+// Called when parent lost a child, closed parent without children is either reopened or dead
+static void isla__sma_orphan( isla__sma *sma, isla_node *parent ) {
+	isla__sma_slot *slot = isla__sma_slot_of( sma, parent );
+	if ( --slot->children == 0 && parent->status == ISLA_NODE_CLOSED && parent != sma->expanding ) {
+		if ( slot->has_forgotten ) {
+			parent->f = parent->f < slot->forgotten ? slot->forgotten : parent->f;
+			parent->status = ISLA_NODE_OPENED;
+			slot->has_forgotten = 0;
+			isla__sma_push_open( sma, (size_t) (slot - sma->slots) );
+		} else {
+			isla__sma_release( sma, parent, 1 );
+		}
+	}
+}
+
+static void isla__sma_release( isla__sma *sma, isla_node *node, int dead ) {
+	size_t index = isla__sma_index_of( sma, node );
+	isla_node *parent = node->parent;
+	if ( node->status == ISLA_NODE_OPENED ) {
+		isla__heap_remove( &sma->open, node );
+		isla__sma_forget_open( sma, index );
+	}
+	if ( parent != NULL && !dead ) {
+		isla__sma_remember( isla__sma_slot_of( sma, parent ), node->f );
+	}
+	sma->slots[index].node = NULL;
+	sma->free[sma->nfree++] = index;
+	isla__map_remove( &sma->map, (size_t) node );
+	isla__reset_node( node );
+	if ( parent != NULL ) {
+		isla__sma_orphan( sma, parent );
+	}
+}
+
+static isla_node *isla__sma_worst_leaf( isla__sma *sma ) {
+	return sma->worst_length > 0 ? sma->slots[sma->worst[0]].node : NULL;
+}
+
+isla_result isla_find_path_sma( isla_node *start, isla_node *finish, isla_properties *properties, size_t max_nodes, void *userdata ) {
+	isla_result result = {ISLA_BLOCKED,NULL};
+	isla__sma sma;
+	size_t expansions = 0;
+	size_t max_expansions;
+	size_t i;
+
+	if ( start == NULL || finish == NULL || properties == NULL || max_nodes < 2 ) {
+		result.status = ISLA_ERROR_BAD_ARGUMENTS;
+		return result;
+	}
+
+	// Forgetting and regenerating can cycle when the budget is too tight, so the work is always
+	// bounded: by max_expansions if set, otherwise by max_nodes^2 (saturated on overflow)
+	if ( properties->max_expansions > 0 ) {
+		max_expansions = properties->max_expansions;
+	} else {
+		max_expansions = max_nodes > ((size_t) -1) / max_nodes ? (size_t) -1 : max_nodes * max_nodes;
+	}
+
+	// All memory is allocated upfront, search itself never grows anything
+	sma.open.nodes = ISLA_MALLOC( max_nodes * sizeof( *sma.open.nodes ));
+	sma.slots = ISLA_MALLOC( max_nodes * sizeof( *sma.slots ));
+	sma.free = ISLA_MALLOC( max_nodes * sizeof( *sma.free ));
+	sma.worst = ISLA_MALLOC( max_nodes * sizeof( *sma.worst ));
+	sma.map.entries = NULL;
+	if ( sma.open.nodes == NULL || sma.slots == NULL || sma.free == NULL || sma.worst == NULL || isla__map_init( &sma.map, max_nodes ) != ISLA_OK ) {
+		ISLA_FREE( sma.open.nodes );
+		ISLA_FREE( sma.slots );
+		ISLA_FREE( sma.free );
+		ISLA_FREE( sma.worst );
+		result.status = ISLA_ERROR_BAD_ALLOC;
+		return result;
+	}
+	sma.open.allocated = max_nodes;
+	sma.open.length = 0;
+	sma.nfree = max_nodes;
+	sma.worst_length = 0;
+	for ( i = 0; i < max_nodes; i++ ) {
+		sma.slots[i].node = NULL;
+		sma.free[i] = max_nodes - i - 1;
+	}
+
+	sma.expanding = NULL;
+	isla__sma_add( &sma, start, NULL, 0, properties->estimate_cost( start, finish, userdata ));
+
+	while ( sma.open.length > 0 && result.status == ISLA_BLOCKED ) {
+		isla_node *node = isla__heap_dequeue( &sma.open );
+		isla_node *neighbor = NULL;
+		isla__sma_slot *slot;
+		isla__sma_forget_open( &sma, isla__sma_index_of( &sma, node ));
+		node->status = ISLA_NODE_CLOSED;
+
+		if ( isla__is_finish( node, finish, properties, userdata )) {
+			result = isla__build_path( node );
+			break;
+		}
+
+		if ( ++expansions > max_expansions ) {
+			result.status = ISLA_LIMIT_REACHED;
+			break;
+		}
+
+		sma.expanding = node;
+		while ( (neighbor = properties->next_neighbor( node, neighbor, userdata ))) {
+			isla_cost g = node->g + properties->eval_cost( node, neighbor, userdata );
+			isla_cost f;
+
+			if ( neighbor->status == ISLA_NODE_OPENED ) {
+				if ( g < neighbor->g ) {
+					isla_node *parent = neighbor->parent;
+					neighbor->f += g - neighbor->g;
+					neighbor->g = g;
+					neighbor->parent = node;
+					isla__sma_slot_of( &sma, node )->children++;
+					isla__heap_update( &sma.open, neighbor );
+					isla__sma_worst_siftdown( &sma, isla__sma_slot_of( &sma, neighbor )->worst );
+					if ( parent != NULL ) {
+						isla__sma_orphan( &sma, parent );
+					}
+				}
+				continue;
+			} else if ( neighbor->status == ISLA_NODE_CLOSED ) {
+				continue;
+			}
+
+			// Pathmax keeps f monotone along the path, so forgotten values stay meaningful
+			f = g + properties->estimate_cost( neighbor, finish, userdata );
+			f = f < node->f ? node->f : f;
+
+			if ( sma.nfree == 0 ) {
+				isla_node *worst = isla__sma_worst_leaf( &sma );
+				if ( worst == NULL ) {
+					result.status = ISLA_LIMIT_REACHED;
+					break;
+				} else if ( worst->f <= f ) {
+					isla__sma_remember( isla__sma_slot_of( &sma, node ), f );
+					continue;
+				}
+				isla__sma_release( &sma, worst, 0 );
+			}
+
+			isla__sma_add( &sma, neighbor, node, g, f );
+		}
+		sma.expanding = NULL;
+
+		slot = isla__sma_slot_of( &sma, node );
+		if ( result.status == ISLA_BLOCKED && slot->children == 0 ) {
+			if ( slot->has_forgotten ) {
+				node->f = slot->forgotten;
+				node->status = ISLA_NODE_OPENED;
+				slot->has_forgotten = 0;
+				isla__sma_push_open( &sma, (size_t) (slot - sma.slots) );
+			} else {
+				isla__sma_release( &sma, node, 1 );
+			}
+		}
+	}
+
+	for ( i = 0; i < max_nodes; i++ ) {
+		if ( sma.slots[i].node != NULL ) {
+			isla__reset_node( sma.slots[i].node );
+		}
+	}
+	isla__map_destroy( &sma.map );
+	ISLA_FREE( sma.open.nodes );
+	ISLA_FREE( sma.slots );
+	ISLA_FREE( sma.free );
+	ISLA_FREE( sma.worst );
+
+	return isla__backend_result( properties, result );
+}
+// End of memory-bounded A*
+
+// Built-in grid backends. Grid is padded by one blocked cell on every side, so neighbors are
+// enumerated by table of index offsets without bounds checks. Diagonal moves require all
+// cells on the straight paths around the corner to be free, i.e. no corner cutting.
+static const signed char isla__hex_directions[6][2] = {{1,0},{0,1},{-1,1},{-1,0},{0,-1},{1,-1}};
+
+static int isla__grid_is_3d( isla_grid_topology topology ) {
+	return topology >= ISLA_GRID_VOXEL6;
+}
+
+static void isla__grid_add_direction( isla_grid *grid, int dx, int dy, int dz ) {
+	int dir = grid->directions++;
+	int k = (dx != 0) + (dy != 0) + (dz != 0);
+	int mask;
+	int guard = 0;
+	grid->offsets[dir] = dx + dy * (ptrdiff_t) grid->stride_y + dz * (ptrdiff_t) grid->stride_z;
+	grid->costs[dir] = (isla_cost) (k == 1 || grid->topology == ISLA_GRID_HEX ? ISLA_GRID_COST_STRAIGHT : k == 2 ? ISLA_GRID_COST_DIAGONAL : ISLA_GRID_COST_DIAGONAL3);
+	grid->lookup[(dx+1) + (dy+1)*3 + (dz+1)*9] = (signed char) dir;
+	if ( grid->topology != ISLA_GRID_HEX ) {
+		// Every proper non-empty subset of the move components is a cell which must be free
+		for ( mask = 1; mask < 7; mask++ ) {
+			int sx = (mask & 1) ? dx : 0;
+			int sy = (mask & 2) ? dy : 0;
+			int sz = (mask & 4) ? dz : 0;
+			int n = (sx != 0) + (sy != 0) + (sz != 0);
+			if ( n == ((mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1)) && n < k ) {
+				grid->guards[dir][guard++] = sx + sy * (ptrdiff_t) grid->stride_y + sz * (ptrdiff_t) grid->stride_z;
+			}
+		}
+	}
+	grid->guards[dir][guard] = 0;
+}
+
+isla_status isla_grid_init( isla_grid *grid, isla_grid_topology topology, int width, int height, int depth ) {
+	size_t size;
+	size_t planes;
+	size_t limit;
+	size_t i;
+	int dx, dy, dz;
+
+	if ( width < 1 || height < 1 || depth < 1 || (depth > 1 && !isla__grid_is_3d( topology ))) {
+		return ISLA_ERROR_BAD_ARGUMENTS;
+	}
+	// Padded size must fit both the allocation and signed index deltas
+	planes = isla__grid_is_3d( topology ) ? (size_t) depth + 2 : 1;
+	limit = ((size_t) -1 >> 1) / sizeof( *grid->nodes );
+	if ( (size_t) width + 2 > limit / ((size_t) height + 2) || ((size_t) width + 2) * ((size_t) height + 2) > limit / planes ) {
+		return ISLA_ERROR_BAD_ARGUMENTS;
+	}
+
+	grid->topology = topology;
+	grid->width = width;
+	grid->height = height;
+	grid->depth = depth;
+	grid->stride_y = (size_t) width + 2;
+	grid->stride_z = grid->stride_y * ((size_t) height + 2);
+	grid->directions = 0;
+	for ( i = 0; i < 27; i++ ) {
+		grid->lookup[i] = -1;
+	}
+
+	size = grid->stride_z * planes;
+	grid->nodes = ISLA_MALLOC( size * sizeof( *grid->nodes ));
+	grid->blocked = ISLA_MALLOC( (size + 7) / 8 );
+	if ( grid->nodes == NULL || grid->blocked == NULL ) {
+		ISLA_FREE( grid->nodes );
+		ISLA_FREE( grid->blocked );
+		grid->nodes = NULL;
+		grid->blocked = NULL;
+		return ISLA_ERROR_BAD_ALLOC;
+	}
+	for ( i = 0; i < size; i++ ) {
+		isla__reset_node( grid->nodes + i );
+		grid->nodes[i].data = NULL;
+	}
+	for ( i = 0; i < (size + 7) / 8; i++ ) {
+		grid->blocked[i] = 0xff;
+	}
+	if ( topology == ISLA_GRID_HEX ) {
+		for ( i = 0; i < 6; i++ ) {
+			isla__grid_add_direction( grid, isla__hex_directions[i][0], isla__hex_directions[i][1], 0 );
+		}
+	} else {
+		int maxk = topology == ISLA_GRID_SQUARE4 || topology == ISLA_GRID_VOXEL6 ? 1 : topology == ISLA_GRID_VOXEL18 || topology == ISLA_GRID_SQUARE8 ? 2 : 3;
+		int k;
+		// Straight moves go first, diagonals after them
+		for ( k = 1; k <= maxk; k++ ) {
+			for ( dz = -1; dz <= 1; dz++ ) {
+				for ( dy = -1; dy <= 1; dy++ ) {
+					for ( dx = -1; dx <= 1; dx++ ) {
+						if ( (dx != 0) + (dy != 0) + (dz != 0) == k && (dz == 0 || isla__grid_is_3d( topology ))) {
+							isla__grid_add_direction( grid, dx, dy, dz );
+						}
+					}
+				}
+			}
+		}
+	}
+
+	for ( dz = 0; dz < depth; dz++ ) {
+		for ( dy = 0; dy < height; dy++ ) {
+			for ( dx = 0; dx < width; dx++ ) {
+				isla_grid_set_blocked( grid, dx, dy, dz, 0 );
+			}
+		}
+	}
+	return ISLA_OK;
+}
+
+void isla_grid_destroy( isla_grid *grid ) {
+	ISLA_FREE( grid->nodes );
+	ISLA_FREE( grid->blocked );
+	grid->nodes = NULL;
+	grid->blocked = NULL;
+}
+
+static size_t isla__grid_index( const isla_grid *grid, int x, int y, int z ) {
+	return (size_t) (x + 1) + (size_t) (y + 1) * grid->stride_y + (isla__grid_is_3d( grid->topology ) ? (size_t) (z + 1) * grid->stride_z : 0);
+}
+
+#define ISLA__GRID_BLOCKED(grid,index) ((grid)->blocked[(index) >> 3] & (1 << ((index) & 7)))
+
+void isla_grid_set_blocked( isla_grid *grid, int x, int y, int z, int blocked ) {
+	size_t index;
+	if ( x < 0 || y < 0 || z < 0 || x >= grid->width || y >= grid->height || z >= grid->depth ) {
+		return;
+	}
+	index = isla__grid_index( grid, x, y, z );
+	if ( blocked ) {
+		grid->blocked[index >> 3] |= (unsigned char) (1 << (index & 7));
+	} else {
+		grid->blocked[index >> 3] &= (unsigned char) ~(1 << (index & 7));
+	}
+}
+
+int isla_grid_is_blocked( const isla_grid *grid, int x, int y, int z ) {
+	if ( x < 0 || y < 0 || z < 0 || x >= grid->width || y >= grid->height || z >= grid->depth ) {
+		return 1;
+	}
+	return ISLA__GRID_BLOCKED( grid, isla__grid_index( grid, x, y, z )) != 0;
+}
+
+isla_node *isla_grid_node( isla_grid *grid, int x, int y, int z ) {
+	if ( x < 0 || y < 0 || z < 0 || x >= grid->width || y >= grid->height || z >= grid->depth ) {
+		return NULL;
+	}
+	return grid->nodes + isla__grid_index( grid, x, y, z );
+}
+
+void isla_grid_coords( const isla_grid *grid, const isla_node *node, int *x, int *y, int *z ) {
+	size_t index = (size_t) (node - grid->nodes);
+	size_t plane = index % grid->stride_z;
+	*x = (int) (plane % grid->stride_y) - 1;
+	*y = (int) (plane / grid->stride_y) - 1;
+	*z = isla__grid_is_3d( grid->topology ) ? (int) (index / grid->stride_z) - 1 : 0;
+}
+
+// Direction of the neighbor is restored from the index delta by comparisons instead of division:
+// every component is -1..1 and the rest of the delta is smaller than the next stride, so the sign
+// of what's left after removing larger strides is the component
+static int isla__grid_direction( const isla_grid *grid, ptrdiff_t delta ) {
+	ptrdiff_t stride_y = (ptrdiff_t) grid->stride_y;
+	ptrdiff_t dy, dz = 0;
+	if ( isla__grid_is_3d( grid->topology )) {
+		dz = (delta > stride_y + 1) - (delta < -stride_y - 1);
+		delta -= dz * (ptrdiff_t) grid->stride_z;
+	}
+	dy = (delta > 1) - (delta < -1);
+	delta -= dy * stride_y;
+	return grid->lookup[(delta + 1) + (dy + 1)*3 + (dz + 1)*9];
+}
+
+isla_node *isla_grid_next_neighbor( isla_node *node, isla_node *prev, void *userdata ) {
+	const isla_grid *grid = userdata;
+	ptrdiff_t index = node - grid->nodes;
+	int dir = prev == NULL ? 0 : isla__grid_direction( grid, prev - node ) + 1;
+	for ( ; dir < grid->directions; dir++ ) {
+		ptrdiff_t neighbor = index + grid->offsets[dir];
+		if ( !ISLA__GRID_BLOCKED( grid, neighbor )) {
+			const ptrdiff_t *guard = grid->guards[dir];
+			while ( *guard != 0 && !ISLA__GRID_BLOCKED( grid, index + *guard )) {
+				guard++;
+			}
+			if ( *guard == 0 ) {
+				return grid->nodes + neighbor;
+			}
+		}
+	}
+	return NULL;
+}
+
+isla_cost isla_grid_eval_cost( isla_node *node1, isla_node *node2, void *userdata ) {
+	const isla_grid *grid = userdata;
+	return grid->costs[isla__grid_direction( grid, node2 - node1 )];
+}
+
+isla_cost isla_grid_estimate_cost( isla_node *node1, isla_node *node2, void *userdata ) {
+	const isla_grid *grid = userdata;
+	int x1, y1, z1, x2, y2, z2;
+	int a, b, c, t;
+	isla_grid_coords( grid, node1, &x1, &y1, &z1 );
+	isla_grid_coords( grid, node2, &x2, &y2, &z2 );
+	a = x1 > x2 ? x1 - x2 : x2 - x1;
+	b = y1 > y2 ? y1 - y2 : y2 - y1;
+	c = z1 > z2 ? z1 - z2 : z2 - z1;
+	if ( grid->topology == ISLA_GRID_HEX ) {
+		int dq = x2 - x1;
+		int dr = y2 - y1;
+		int ds = dq + dr;
+		return (isla_cost) ((a + b + (ds < 0 ? -ds : ds)) / 2) * ISLA_GRID_COST_STRAIGHT;
+	}
+	// Sort components, a >= b >= c
+	if ( a < b ) { t = a; a = b; b = t; }
+	if ( b < c ) { t = b; b = c; c = t; }
+	if ( a < b ) { t = a; a = b; b = t; }
+	switch ( grid->topology ) {
+		case ISLA_GRID_SQUARE8:
+			return (isla_cost) (b * ISLA_GRID_COST_DIAGONAL + (a - b) * ISLA_GRID_COST_STRAIGHT);
+		case ISLA_GRID_VOXEL18:
+			if ( a >= b + c ) {
+				return (isla_cost) ((b + c) * ISLA_GRID_COST_DIAGONAL + (a - b - c) * ISLA_GRID_COST_STRAIGHT);
+			}
+			return (isla_cost) ((a + b + c) * ISLA_GRID_COST_DIAGONAL / 2);
+		case ISLA_GRID_VOXEL26:
+			return (isla_cost) (c * ISLA_GRID_COST_DIAGONAL3 + (b - c) * ISLA_GRID_COST_DIAGONAL + (a - b) * ISLA_GRID_COST_STRAIGHT);
+		default:
+			return (isla_cost) ((a + b + c) * ISLA_GRID_COST_STRAIGHT);
+	}
+}
+
+void isla_grid_properties( isla_grid *grid, isla_properties *properties ) {
+	(void) grid;
+	properties->next_neighbor = isla_grid_next_neighbor;
+	properties->eval_cost = isla_grid_eval_cost;
+	properties->estimate_cost = isla_grid_estimate_cost;
+}
+
+// Compact grid paths. Code starts with LEB128 varint of the first cell index, then every
+// run of equal moves takes one byte: direction index in the high bits (3 bits for up to
+// 8 directions, 5 bits otherwise) and run length minus one in the low bits.
+static int isla__grid_code_bits( const isla_grid *grid ) {
+	return grid->directions > 8 ? 5 : 3;
+}
+
+static int isla__grid_move( const isla_grid *grid, ptrdiff_t delta ) {
+	int dir;
+	for ( dir = 0; dir < grid->directions; dir++ ) {
+		if ( grid->offsets[dir] == delta ) {
+			return dir;
+		}
+	}
+	return -1;
+}
+
+isla_status isla_grid_encode_path( const isla_grid *grid, const isla_path *path, unsigned char *code, size_t *size ) {
+	int bits = isla__grid_code_bits( grid );
+	unsigned max_run = 1u << (8 - bits);
+	size_t capacity = *size;
+	size_t length = 0;
+	size_t i;
+	size_t index;
+	int dir = -1;
+	unsigned run = 0;
+
+	if ( path == NULL || path->length == 0 ) {
+		*size = 0;
+		return ISLA_OK;
+	}
+
+	for ( index = (size_t) (path->nodes[0] - grid->nodes); ; index >>= 7 ) {
+		if ( length < capacity ) {
+			code[length] = (unsigned char) ((index & 0x7f) | (index >= 0x80 ? 0x80 : 0));
+		}
+		length++;
+		if ( index < 0x80 ) {
+			break;
+		}
+	}
+
+	for ( i = 1; i <= path->length; i++ ) {
+		int next = i < path->length ? isla__grid_move( grid, path->nodes[i] - path->nodes[i-1] ) : -1;
+		if ( i < path->length && next < 0 ) {
+			return ISLA_ERROR_BAD_ARGUMENTS;
+		}
+		if ( run > 0 && (next != dir || run == max_run) ) {
+			if ( length < capacity ) {
+				code[length] = (unsigned char) ((unsigned) dir << (8 - bits) | (run - 1));
+			}
+			length++;
+			run = 0;
+		}
+		dir = next;
+		run++;
+	}
+
+	*size = length;
+	return length <= capacity ? ISLA_OK : ISLA_LIMIT_REACHED;
+}
+
+#define ISLA__GRID_CODE_START ((size_t) -1)
+
+void isla_grid_code_begin( isla_grid_code_iter *iter, const isla_grid *grid, const unsigned char *code, size_t size ) {
+	iter->grid = grid;
+	iter->code = code;
+	iter->size = size;
+	iter->position = 0;
+	iter->index = ISLA__GRID_CODE_START;
+	iter->offset = 0;
+	iter->remaining = 0;
+	iter->status = ISLA_OK;
+}
+
+// Codes are stored and sent, so decoded cells are checked: every one must be inside the grid,
+// padding cells around it are never on a path
+static int isla__grid_is_inner( const isla_grid *grid, size_t index ) {
+	int x, y, z;
+	if ( index >= grid->stride_z * (isla__grid_is_3d( grid->topology ) ? (size_t) grid->depth + 2 : 1) ) {
+		return 0;
+	}
+	isla_grid_coords( grid, grid->nodes + index, &x, &y, &z );
+	return x >= 0 && y >= 0 && z >= 0 && x < grid->width && y < grid->height && z < grid->depth;
+}
+
+static isla_node *isla__grid_code_corrupt( isla_grid_code_iter *iter ) {
+	iter->position = iter->size;
+	iter->status = ISLA_ERROR_BAD_ARGUMENTS;
+	return NULL;
+}
+
+isla_node *isla_grid_code_next( isla_grid_code_iter *iter ) {
+	const isla_grid *grid = iter->grid;
+	if ( iter->status != ISLA_OK ) {
+		return NULL;
+	}
+	if ( iter->index == ISLA__GRID_CODE_START ) {
+		size_t index = 0;
+		int shift = 0;
+		unsigned char byte = 0x80;
+		if ( iter->size == 0 ) {
+			return NULL;
+		}
+		while ( (byte & 0x80) && iter->position < iter->size ) {
+			size_t bits;
+			byte = iter->code[iter->position++];
+			bits = (size_t) (byte & 0x7f);
+			// Varint longer than size_t or with bits above it isn't produced by the encoder
+			if ( shift >= (int) sizeof( size_t ) * 8 || (bits << shift) >> shift != bits ) {
+				return isla__grid_code_corrupt( iter );
+			}
+			index |= bits << shift;
+			shift += 7;
+		}
+		if ( (byte & 0x80) || !isla__grid_is_inner( grid, index )) {
+			return isla__grid_code_corrupt( iter );
+		}
+		iter->index = index;
+		return grid->nodes + iter->index;
+	}
+	if ( iter->remaining == 0 ) {
+		int bits = isla__grid_code_bits( grid );
+		unsigned char byte;
+		int dir;
+		if ( iter->position >= iter->size ) {
+			return NULL;
+		}
+		byte = iter->code[iter->position++];
+		dir = byte >> (8 - bits);
+		if ( dir >= grid->directions ) {
+			return isla__grid_code_corrupt( iter );
+		}
+		iter->offset = grid->offsets[dir];
+		iter->remaining = (byte & ((1u << (8 - bits)) - 1)) + 1;
+	}
+	iter->remaining--;
+	// Step from an inner cell stays within padding, so the index is checked only after it
+	iter->index = (size_t) ((ptrdiff_t) iter->index + iter->offset);
+	if ( !isla__grid_is_inner( grid, iter->index )) {
+		return isla__grid_code_corrupt( iter );
+	}
+	return grid->nodes + iter->index;
+}
+
+isla_result isla_grid_decode_path( const isla_grid *grid, const unsigned char *code, size_t size ) {
+	isla_result result = {ISLA_OK, isla__path_create( size * 4 )};
+	isla_grid_code_iter iter;
+	isla_node *node;
+	if ( result.path == NULL ) {
+		result.status = ISLA_ERROR_BAD_ALLOC;
+		return result;
+	}
+	isla_grid_code_begin( &iter, grid, code, size );
+	while ( result.status == ISLA_OK && (node = isla_grid_code_next( &iter )) != NULL ) {
+		result.status = isla__path_push( result.path, node );
+	}
+	if ( result.status == ISLA_OK ) {
+		result.status = iter.status;
+	}
+	if ( result.status != ISLA_OK ) {
+		isla_destroy_path( result.path );
+		result.path = NULL;
+	}
+	return result;
+}
+// End of built-in grid backends
+
+
+// Simple subgoal graph for 8-connected grids. Subgoals are free cells at convex obstacle
+// corners, each one is connected to subgoals which are directly h-reachable, i.e. reachable
+// by an octile-length path which doesn't pass another subgoal. Query connects start and goal
+// the same way, searches the small graph and refines every edge into grid moves.
+#define ISLA__SG_START(sg) ((sg)->nodes + (sg)->count)
+#define ISLA__SG_GOAL(sg) ((sg)->nodes + (sg)->count + 1)
+
+static int isla__sg_free( const isla_grid *grid, int x, int y ) {
+	return !isla_grid_is_blocked( grid, x, y, 0 );
+}
+
+static isla_node *isla__sg_subgoal( isla_subgoal_graph *sg, int x, int y ) {
+	size_t *id;
+	if ( !isla__sg_free( sg->grid, x, y )) {
+		return NULL;
+	}
+	id = isla__map_get( &sg->lookup, isla__grid_index( sg->grid, x, y, 0 ));
+	return id != NULL ? sg->nodes + *id : NULL;
+}
+
+static int isla__sg_is_corner( const isla_grid *grid, int x, int y ) {
+	int dx, dy;
+	for ( dy = -1; dy <= 1; dy += 2 ) {
+		for ( dx = -1; dx <= 1; dx += 2 ) {
+			if ( !isla__sg_free( grid, x + dx, y + dy ) && isla__sg_free( grid, x + dx, y ) && isla__sg_free( grid, x, y + dy )) {
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+// Walks from (x,y) until obstacle or subgoal, which is added to out if it's not NULL and at
+// most max + 1 cells away. Returns clearance, the number of free cells before the stop (at most max)
+static int isla__sg_scan( isla_subgoal_graph *sg, int x, int y, int dx, int dy, int max, isla_path *out, isla_status *status ) {
+	int j;
+	for ( j = 1; j <= max + 1; j++ ) {
+		isla_node *subgoal;
+		if ( !isla__sg_free( sg->grid, x + j * dx, y + j * dy )) {
+			return j - 1;
+		}
+		subgoal = isla__sg_subgoal( sg, x + j * dx, y + j * dy );
+		if ( subgoal != NULL ) {
+			if ( out != NULL && *status == ISLA_OK ) {
+				*status = isla__path_push( out, subgoal );
+			}
+			return j - 1;
+		}
+	}
+	return max;
+}
+
+// Clearance based exploration: cardinal rays first, then every diagonal ray with cardinal
+// scans bounded by the previous row, so cells behind found subgoals are never reached
+static isla_status isla__sg_reachable( isla_subgoal_graph *sg, int x, int y, isla_path *out ) {
+	const isla_grid *grid = sg->grid;
+	int far = grid->width + grid->height;
+	isla_status status = ISLA_OK;
+	int dx, dy;
+	isla__sg_scan( sg, x, y, 1, 0, far, out, &status );
+	isla__sg_scan( sg, x, y, -1, 0, far, out, &status );
+	isla__sg_scan( sg, x, y, 0, 1, far, out, &status );
+	isla__sg_scan( sg, x, y, 0, -1, far, out, &status );
+	for ( dy = -1; dy <= 1; dy += 2 ) {
+		for ( dx = -1; dx <= 1; dx += 2 ) {
+			int max1 = isla__sg_scan( sg, x, y, dx, 0, far, NULL, &status );
+			int max2 = isla__sg_scan( sg, x, y, 0, dy, far, NULL, &status );
+			int cx = x;
+			int cy = y;
+			while ( isla__sg_free( grid, cx + dx, cy + dy ) && isla__sg_free( grid, cx + dx, cy ) && isla__sg_free( grid, cx, cy + dy )) {
+				isla_node *subgoal;
+				cx += dx;
+				cy += dy;
+				subgoal = isla__sg_subgoal( sg, cx, cy );
+				if ( subgoal != NULL ) {
+					if ( status == ISLA_OK ) {
+						status = isla__path_push( out, subgoal );
+					}
+					break;
+				}
+				max1 = isla__sg_scan( sg, cx, cy, dx, 0, max1, out, &status );
+				max2 = isla__sg_scan( sg, cx, cy, 0, dy, max2, out, &status );
+			}
+		}
+	}
+	return status;
+}
+
+static isla_cost isla__sg_octile( int x0, int y0, int x1, int y1 ) {
+	int a = x0 > x1 ? x0 - x1 : x1 - x0;
+	int b = y0 > y1 ? y0 - y1 : y1 - y0;
+	return a > b ? (isla_cost) (b * ISLA_GRID_COST_DIAGONAL + (a - b) * ISLA_GRID_COST_STRAIGHT) : (isla_cost) (a * ISLA_GRID_COST_DIAGONAL + (b - a) * ISLA_GRID_COST_STRAIGHT);
+}
+
+// Octile-length paths consist of diagonal moves and straight moves along the major axis only,
+// so reachability is a DP over the band of (diagonals, straights) counts. If out is not NULL
+// the cells after (x0,y0) are appended to it.
+static isla_status isla__sg_refine( isla_subgoal_graph *sg, int x0, int y0, int x1, int y1, isla_path *out, int *reachable ) {
+	const isla_grid *grid = sg->grid;
+	int sx = x1 > x0 ? 1 : -1;
+	int sy = y1 > y0 ? 1 : -1;
+	int ax = x1 > x0 ? x1 - x0 : x0 - x1;
+	int ay = y1 > y0 ? y1 - y0 : y0 - y1;
+	int major_x = ax >= ay;
+	int mx = major_x ? sx : 0;
+	int my = major_x ? 0 : sy;
+	int m = ax < ay ? ax : ay;
+	int n = ax < ay ? ay - ax : ax - ay;
+	size_t size = (size_t) (m + 1) * (size_t) (n + 1);
+	isla_status status = ISLA_OK;
+	int i, k;
+
+	if ( sg->band_size < size ) {
+		unsigned char *band = ISLA_REALLOC( sg->band, size );
+		if ( band == NULL ) {
+			return ISLA_ERROR_BAD_REALLOC;
+		}
+		sg->band = band;
+		sg->band_size = size;
+	}
+	for ( i = 0; i <= m; i++ ) {
+		for ( k = 0; k <= n; k++ ) {
+			int x = x0 + i * sx + k * mx;
+			int y = y0 + i * sy + k * my;
+			unsigned char r = 0;
+			if ( isla__sg_free( grid, x, y )) {
+				if ( i == 0 && k == 0 ) {
+					r = 1;
+				}
+				if ( k > 0 && sg->band[i * (n + 1) + k - 1] ) {
+					r = 1;
+				}
+				if ( i > 0 && sg->band[(i - 1) * (n + 1) + k] && isla__sg_free( grid, x - sx, y ) && isla__sg_free( grid, x, y - sy )) {
+					r = 1;
+				}
+			}
+			sg->band[i * (n + 1) + k] = r;
+		}
+	}
+	*reachable = sg->band[size - 1];
+	if ( *reachable && out != NULL ) {
+		size_t first = out->length;
+		size_t l, r;
+		i = m;
+		k = n;
+		// Backtracking yields cells in reverse order, they are flipped in place afterwards
+		while ( status == ISLA_OK && (i > 0 || k > 0)) {
+			int x = x0 + i * sx + k * mx;
+			int y = y0 + i * sy + k * my;
+			status = isla__path_push( out, grid->nodes + isla__grid_index( grid, x, y, 0 ));
+			if ( k > 0 && sg->band[i * (n + 1) + k - 1] ) {
+				k--;
+			} else {
+				i--;
+			}
+		}
+		for ( l = first, r = out->length; l + 1 < r; l++, r-- ) {
+			isla_node *tmp = out->nodes[l];
+			out->nodes[l] = out->nodes[r - 1];
+			out->nodes[r - 1] = tmp;
+		}
+	}
+	return status;
+}
+
+isla_status isla_subgoal_init( isla_subgoal_graph *sg, isla_grid *grid ) {
+	isla_status status = ISLA_OK;
+	isla_path edges;
+	size_t count = 0;
+	size_t i;
+	int x, y;
+
+	if ( grid == NULL || grid->topology != ISLA_GRID_SQUARE8 ) {
+		return ISLA_ERROR_BAD_ARGUMENTS;
+	}
+
+	sg->grid = grid;
+	sg->count = 0;
+	sg->cells = NULL;
+	sg->nodes = NULL;
+	sg->offsets = NULL;
+	sg->edges = NULL;
+	sg->to_goal = NULL;
+	sg->band = NULL;
+	sg->band_size = 0;
+	sg->start_edges.nodes = NULL;
+	sg->goal_edges.nodes = NULL;
+	edges.nodes = NULL;
+	if ( isla__map_init( &sg->lookup, 64 ) != ISLA_OK ) {
+		return ISLA_ERROR_BAD_ALLOC;
+	}
+
+	for ( y = 0; y < grid->height && status == ISLA_OK; y++ ) {
+		for ( x = 0; x < grid->width && status == ISLA_OK; x++ ) {
+			if ( isla__sg_free( grid, x, y ) && isla__sg_is_corner( grid, x, y )) {
+				status = isla__map_put( &sg->lookup, isla__grid_index( grid, x, y, 0 ), count++ );
+			}
+		}
+	}
+
+	// Two extra slots are for start and goal of the query
+	if ( status == ISLA_OK ) {
+		sg->count = count;
+		sg->cells = ISLA_MALLOC( (count + 2) * sizeof( *sg->cells ));
+		sg->nodes = ISLA_MALLOC( (count + 2) * sizeof( *sg->nodes ));
+		sg->offsets = ISLA_MALLOC( (count + 1) * sizeof( *sg->offsets ));
+		sg->to_goal = ISLA_MALLOC( count + 2 );
+		if ( sg->cells == NULL || sg->nodes == NULL || sg->offsets == NULL || sg->to_goal == NULL ) {
+			status = ISLA_ERROR_BAD_ALLOC;
+		}
+	}
+	if ( status == ISLA_OK ) {
+		for ( i = 0; i <= sg->lookup.mask; i++ ) {
+			if ( sg->lookup.entries[i].key != 0 ) {
+				sg->cells[sg->lookup.entries[i].value] = sg->lookup.entries[i].key;
+			}
+		}
+		for ( i = 0; i < count + 2; i++ ) {
+			isla__reset_node( sg->nodes + i );
+			sg->nodes[i].data = NULL;
+			sg->to_goal[i] = 0;
+		}
+		edges.nodes = ISLA_MALLOC( count * 8 * sizeof( *edges.nodes ) + sizeof( *edges.nodes ));
+		edges.allocated = count * 8 + 1;
+		edges.length = 0;
+		sg->start_edges = edges;
+		sg->start_edges.nodes = ISLA_MALLOC( ISLA_MAX_NEIGHBORS * sizeof( *edges.nodes ));
+		sg->start_edges.allocated = ISLA_MAX_NEIGHBORS;
+		sg->goal_edges = sg->start_edges;
+		sg->goal_edges.nodes = ISLA_MALLOC( ISLA_MAX_NEIGHBORS * sizeof( *edges.nodes ));
+		if ( edges.nodes == NULL || sg->start_edges.nodes == NULL || sg->goal_edges.nodes == NULL ) {
+			status = ISLA_ERROR_BAD_ALLOC;
+		}
+	}
+
+	// Adjacency is stored as offsets into one array of neighbor nodes
+	for ( i = 0; i < count && status == ISLA_OK; i++ ) {
+		int z;
+		sg->offsets[i] = edges.length;
+		isla_grid_coords( grid, grid->nodes + sg->cells[i], &x, &y, &z );
+		status = isla__sg_reachable( sg, x, y, &edges );
+	}
+	if ( status == ISLA_OK ) {
+		sg->offsets[count] = edges.length;
+		sg->edges = edges.nodes;
+	} else {
+		ISLA_FREE( edges.nodes );
+		isla_subgoal_destroy( sg );
+	}
+	return status;
+}
+
+void isla_subgoal_destroy( isla_subgoal_graph *sg ) {
+	isla__map_destroy( &sg->lookup );
+	ISLA_FREE( sg->cells );
+	ISLA_FREE( sg->nodes );
+	ISLA_FREE( sg->offsets );
+	ISLA_FREE( sg->edges );
+	ISLA_FREE( sg->to_goal );
+	ISLA_FREE( sg->band );
+	ISLA_FREE( sg->start_edges.nodes );
+	ISLA_FREE( sg->goal_edges.nodes );
+	sg->cells = NULL;
+	sg->nodes = NULL;
+	sg->offsets = NULL;
+	sg->edges = NULL;
+	sg->to_goal = NULL;
+	sg->band = NULL;
+	sg->start_edges.nodes = NULL;
+	sg->goal_edges.nodes = NULL;
+}
+
+// Goal slot is a virtual last neighbor of subgoals which directly h-reach the goal
+isla_node *isla_subgoal_next_neighbor( isla_node *node, isla_node *prev, void *userdata ) {
+	isla_subgoal_graph *sg = userdata;
+	size_t id = (size_t) (node - sg->nodes);
+	isla_node **edges;
+	size_t degree;
+	size_t i = 0;
+	if ( id == sg->count ) {
+		edges = sg->start_edges.nodes;
+		degree = sg->start_edges.length;
+	} else if ( id < sg->count ) {
+		edges = sg->edges + sg->offsets[id];
+		degree = sg->offsets[id + 1] - sg->offsets[id];
+	} else {
+		return NULL;
+	}
+	if ( prev == ISLA__SG_GOAL( sg )) {
+		return NULL;
+	} else if ( prev != NULL ) {
+		while ( i < degree && edges[i] != prev ) {
+			i++;
+		}
+		i++;
+	}
+	if ( i < degree ) {
+		return edges[i];
+	}
+	return sg->to_goal[id] ? ISLA__SG_GOAL( sg ) : NULL;
+}
+
+isla_cost isla_subgoal_eval_cost( isla_node *node1, isla_node *node2, void *userdata ) {
+	isla_subgoal_graph *sg = userdata;
+	int x0, y0, x1, y1, z;
+	isla_grid_coords( sg->grid, sg->grid->nodes + sg->cells[node1 - sg->nodes], &x0, &y0, &z );
+	isla_grid_coords( sg->grid, sg->grid->nodes + sg->cells[node2 - sg->nodes], &x1, &y1, &z );
+	return isla__sg_octile( x0, y0, x1, y1 );
+}
+
+// Returns path of grid nodes reversed like isla_find_path does. Only the abstract search uses
+// properties, so its limits and workspace apply to the subgoal graph.
+isla_result isla_subgoal_find_path( isla_subgoal_graph *sg, int x0, int y0, int x1, int y1, isla_properties *properties ) {
+	isla_properties local = {0};
+	isla_result result = {ISLA_OK,NULL};
+	isla_result abstract;
+	isla_node *start;
+	isla_node *goal;
+	int reachable = 0;
+	size_t i;
+
+	if ( sg == NULL || isla_grid_node( sg->grid, x0, y0, 0 ) == NULL || isla_grid_node( sg->grid, x1, y1, 0 ) == NULL ) {
+		result.status = ISLA_ERROR_BAD_ARGUMENTS;
+		return result;
+	}
+	if ( !isla__sg_free( sg->grid, x0, y0 ) || !isla__sg_free( sg->grid, x1, y1 )) {
+		result.status = ISLA_BLOCKED;
+		return result;
+	}
+
+	result.path = isla__path_create( 16 );
+	if ( result.path == NULL ) {
+		result.status = ISLA_ERROR_BAD_ALLOC;
+		return result;
+	}
+	result.status = isla__path_push( result.path, isla_grid_node( sg->grid, x0, y0, 0 ));
+	if ( result.status == ISLA_OK ) {
+		result.status = isla__sg_refine( sg, x0, y0, x1, y1, result.path, &reachable );
+	}
+	if ( result.status != ISLA_OK || reachable ) {
+		if ( result.status == ISLA_OK ) {
+			isla_reverse_path( result.path );
+		} else {
+			isla_destroy_path( result.path );
+			result.path = NULL;
+		}
+		return result;
+	}
+
+	// Start and goal which aren't subgoals take temporary slots with their own edges
+	start = isla__sg_subgoal( sg, x0, y0 );
+	goal = isla__sg_subgoal( sg, x1, y1 );
+	sg->start_edges.length = 0;
+	sg->goal_edges.length = 0;
+	if ( start == NULL ) {
+		start = ISLA__SG_START( sg );
+		sg->cells[sg->count] = isla__grid_index( sg->grid, x0, y0, 0 );
+		result.status = isla__sg_reachable( sg, x0, y0, &sg->start_edges );
+	}
+	if ( goal == NULL && result.status == ISLA_OK ) {
+		goal = ISLA__SG_GOAL( sg );
+		sg->cells[sg->count + 1] = isla__grid_index( sg->grid, x1, y1, 0 );
+		result.status = isla__sg_reachable( sg, x1, y1, &sg->goal_edges );
+		for ( i = 0; i < sg->goal_edges.length; i++ ) {
+			sg->to_goal[sg->goal_edges.nodes[i] - sg->nodes] = 1;
+		}
+	}
+
+	abstract.status = result.status;
+	abstract.path = NULL;
+	if ( result.status == ISLA_OK ) {
+		if ( properties != NULL ) {
+			local = *properties;
+		}
+		local.next_neighbor = isla_subgoal_next_neighbor;
+		local.eval_cost = isla_subgoal_eval_cost;
+		local.estimate_cost = isla_subgoal_eval_cost;
+		local.is_finish_node = NULL;
+		local.partial = ISLA_PARTIAL_NONE;
+		abstract = isla_find_path( start, goal, &local, sg );
+	}
+	for ( i = 0; i < sg->goal_edges.length; i++ ) {
+		sg->to_goal[sg->goal_edges.nodes[i] - sg->nodes] = 0;
+	}
+
+	// Abstract path goes from the goal to the start, so it's refined from the end
+	result.status = abstract.status;
+	result.path->length = 1;
+	if ( abstract.status == ISLA_OK ) {
+		for ( i = abstract.path->length - 1; i > 0 && result.status == ISLA_OK; i-- ) {
+			int ax, ay, bx, by, z;
+			isla_grid_coords( sg->grid, sg->grid->nodes + sg->cells[abstract.path->nodes[i] - sg->nodes], &ax, &ay, &z );
+			isla_grid_coords( sg->grid, sg->grid->nodes + sg->cells[abstract.path->nodes[i-1] - sg->nodes], &bx, &by, &z );
+			result.status = isla__sg_refine( sg, ax, ay, bx, by, result.path, &reachable );
+			if ( result.status == ISLA_OK && !reachable ) {
+				result.status = ISLA_BLOCKED;
+			}
+		}
+	}
+	isla_destroy_path( abstract.path );
+	if ( result.status == ISLA_OK ) {
+		isla_reverse_path( result.path );
+	} else {
+		isla_destroy_path( result.path );
+		result.path = NULL;
+	}
+	return result;
+}
+// End of subgoal graph
+
+
+// Goal bounding for planar grids. For every cell and every move from it the table keeps the
+// bounding box of goals whose optimal path (one per goal, taken from Dijkstra tree) starts with
+// this move, search skips moves whose box doesn't contain the finish. Table is one flat block,
+// header followed by boxes, so it can be saved and used right from a mapped file.
+#define ISLA__GB_BOX(gb,index,dir) ((gb)->boxes + ((size_t) (index) * (size_t) (gb)->grid->directions + (size_t) (dir)) * 4)
+
+static size_t isla__gb_size( const isla_grid *grid ) {
+	return ISLA__ALIGN( sizeof( isla_gb_header )) + (size_t) grid->stride_z * (size_t) grid->directions * 4 * sizeof( unsigned short );
+}
+
+isla_status isla_gb_build( isla_gb *gb, isla_grid *grid ) {
+	isla_gb_header *header;
+	unsigned short *boxes;
+	unsigned char *first;
+	isla_path *heap;
+	isla_path *reached;
+	isla_status status = ISLA_OK;
+	size_t cells;
+	size_t i;
+	int sx, sy;
+
+	if ( grid == NULL || isla__grid_is_3d( grid->topology ) || grid->width > 0xffff || grid->height > 0xffff ) {
+		return ISLA_ERROR_BAD_ARGUMENTS;
+	}
+
+	cells = (size_t) grid->stride_z;
+	gb->grid = grid;
+	gb->size = isla__gb_size( grid );
+	gb->data = ISLA_MALLOC( gb->size );
+	first = ISLA_MALLOC( cells );
+	heap = isla__path_create( ISLA_MAX_NEIGHBORS );
+	reached = isla__path_create( ISLA_MAX_NEIGHBORS );
+	if ( gb->data == NULL || first == NULL || heap == NULL || reached == NULL ) {
+		ISLA_FREE( gb->data );
+		ISLA_FREE( first );
+		isla_destroy_path( heap );
+		isla_destroy_path( reached );
+		gb->data = NULL;
+		return ISLA_ERROR_BAD_ALLOC;
+	}
+	header = gb->data;
+	header->magic = ISLA_GB_MAGIC;
+	header->version = ISLA_GB_VERSION;
+	header->topology = grid->topology;
+	header->width = grid->width;
+	header->height = grid->height;
+	header->directions = grid->directions;
+	boxes = (unsigned short *) ((unsigned char *) gb->data + ISLA__ALIGN( sizeof( isla_gb_header )));
+	gb->boxes = boxes;
+	// Empty box has min above max
+	for ( i = 0; i < cells * (size_t) grid->directions; i++ ) {
+		boxes[i*4] = 0xffff;
+		boxes[i*4+1] = 0xffff;
+		boxes[i*4+2] = 0;
+		boxes[i*4+3] = 0;
+	}
+
+	// Dijkstra from every free cell, the first move is inherited along the shortest path tree
+	for ( sy = 0; sy < grid->height && status == ISLA_OK; sy++ ) {
+		for ( sx = 0; sx < grid->width && status == ISLA_OK; sx++ ) {
+			isla_node *source = isla_grid_node( grid, sx, sy, 0 );
+			size_t index = (size_t) (source - grid->nodes);
+			isla_node *node;
+			if ( isla_grid_is_blocked( grid, sx, sy, 0 )) {
+				continue;
+			}
+			source->status = ISLA_NODE_OPENED;
+			status = isla__heap_enqueue( heap, source );
+			while ( status == ISLA_OK && (node = isla__heap_dequeue( heap )) != NULL ) {
+				isla_node *neighbor = NULL;
+				node->status = ISLA_NODE_CLOSED;
+				status = isla__path_push( reached, node );
+				while ( status == ISLA_OK && (neighbor = isla_grid_next_neighbor( node, neighbor, grid ))) {
+					if ( neighbor->status != ISLA_NODE_CLOSED ) {
+						isla_cost g = node->g + isla_grid_eval_cost( node, neighbor, grid );
+						if ( neighbor->status == ISLA_NODE_DEFAULT || g < neighbor->g ) {
+							neighbor->g = g;
+							neighbor->f = g;
+							first[neighbor - grid->nodes] = node == source ? (unsigned char) isla__grid_direction( grid, neighbor - node ) : first[node - grid->nodes];
+							if ( neighbor->status == ISLA_NODE_OPENED ) {
+								isla__heap_update( heap, neighbor );
+							} else {
+								neighbor->status = ISLA_NODE_OPENED;
+								status = isla__heap_enqueue( heap, neighbor );
+							}
+						}
+					}
+				}
+			}
+			heap->length = 0;
+			for ( i = 0; i < reached->length; i++ ) {
+				node = reached->nodes[i];
+				if ( node != source ) {
+					unsigned short *box = boxes + (index * (size_t) grid->directions + first[node - grid->nodes]) * 4;
+					int x, y, z;
+					isla_grid_coords( grid, node, &x, &y, &z );
+					if ( x < box[0] ) box[0] = (unsigned short) x;
+					if ( y < box[1] ) box[1] = (unsigned short) y;
+					if ( x > box[2] ) box[2] = (unsigned short) x;
+					if ( y > box[3] ) box[3] = (unsigned short) y;
+				}
+				isla__reset_node( node );
+			}
+			reached->length = 0;
+		}
+	}
+
+	ISLA_FREE( first );
+	isla_destroy_path( heap );
+	isla_destroy_path( reached );
+	if ( status != ISLA_OK ) {
+		isla_gb_destroy( gb );
+	}
+	return status;
+}
+
+// Uses table built for the same grid from external memory (e.g. mapped file) without copying,
+// memory must outlive gb
+isla_status isla_gb_attach( isla_gb *gb, isla_grid *grid, const void *data, size_t size ) {
+	const isla_gb_header *header = data;
+	if ( grid == NULL || data == NULL || size < sizeof( *header ) || size != isla__gb_size( grid ) ||
+		header->magic != ISLA_GB_MAGIC || header->version != ISLA_GB_VERSION || header->topology != (int) grid->topology ||
+		header->width != grid->width || header->height != grid->height || header->directions != grid->directions ) {
+		return ISLA_ERROR_BAD_ARGUMENTS;
+	}
+	gb->grid = grid;
+	gb->data = NULL;
+	gb->size = size;
+	gb->boxes = (const unsigned short *) ((const unsigned char *) data + ISLA__ALIGN( sizeof( isla_gb_header )));
+	return ISLA_OK;
+}
+
+const void *isla_gb_data( const isla_gb *gb, size_t *size ) {
+	*size = gb->size;
+	return (const unsigned char *) gb->boxes - ISLA__ALIGN( sizeof( isla_gb_header ));
+}
+
+void isla_gb_destroy( isla_gb *gb ) {
+	ISLA_FREE( gb->data );
+	gb->data = NULL;
+	gb->boxes = NULL;
+}
+
+void isla_gb_properties( isla_gb *gb, isla_properties *properties ) {
+	(void) gb;
+	properties->next_neighbor = isla_gb_next_neighbor;
+	properties->eval_cost = isla_gb_eval_cost;
+	properties->estimate_cost = isla_gb_estimate_cost;
+	properties->prune_neighbor = isla_gb_prune;
+}
+
+isla_node *isla_gb_next_neighbor( isla_node *node, isla_node *prev, void *userdata ) {
+	return isla_grid_next_neighbor( node, prev, ((isla_gb *) userdata)->grid );
+}
+
+isla_cost isla_gb_eval_cost( isla_node *node1, isla_node *node2, void *userdata ) {
+	return isla_grid_eval_cost( node1, node2, ((isla_gb *) userdata)->grid );
+}
+
+isla_cost isla_gb_estimate_cost( isla_node *node1, isla_node *node2, void *userdata ) {
+	return isla_grid_estimate_cost( node1, node2, ((isla_gb *) userdata)->grid );
+}
+
+int isla_gb_prune( isla_node *node, isla_node *neighbor, isla_node *finish, void *userdata ) {
+	const isla_gb *gb = userdata;
+	const isla_grid *grid = gb->grid;
+	const unsigned short *box = ISLA__GB_BOX( gb, node - grid->nodes, isla__grid_direction( grid, neighbor - node ));
+	int x, y, z;
+	isla_grid_coords( grid, finish, &x, &y, &z );
+	return x < box[0] || y < box[1] || x > box[2] || y > box[3];
+}
+
+#ifndef ISLA_NO_STDIO
+isla_status isla_gb_save( const isla_gb *gb, const char *path ) {
+	size_t size;
+	const void *data = isla_gb_data( gb, &size );
+	FILE *file = fopen( path, "wb" );
+	isla_status status = ISLA_OK;
+	if ( file == NULL ) {
+		return ISLA_ERROR_IO;
+	}
+	if ( fwrite( data, 1, size, file ) != size ) {
+		status = ISLA_ERROR_IO;
+	}
+	if ( fclose( file ) != 0 ) {
+		status = ISLA_ERROR_IO;
+	}
+	return status;
+}
+#endif
+// End of goal bounding
+
+
+// Chunked world backend. Search state lives in per-chunk pages allocated on first touch and
+// kept in hash map by chunk key, occupancy is fetched by loader and kept in LRU cache.
+#define ISLA__CHUNK_NONE ((size_t) -1)
+
+isla_status isla_chunked_init( isla_chunked *world, int width, int height, int diagonal, size_t cache_chunks, isla_chunk_loader loader, void *loader_data ) {
+	if ( width < 1 || height < 1 || cache_chunks < 1 || loader == NULL ) {
+		return ISLA_ERROR_BAD_ARGUMENTS;
+	}
+	world->width = width;
+	world->height = height;
+	world->diagonal = diagonal;
+	world->chunks_x = (width + ISLA_CHUNK_SIZE - 1) >> ISLA_CHUNK_BITS;
+	world->loader = loader;
+	world->loader_data = loader_data;
+	world->cache_size = cache_chunks;
+	world->cache_used = 0;
+	world->lru_head = ISLA__CHUNK_NONE;
+	world->lru_tail = ISLA__CHUNK_NONE;
+	world->loads = 0;
+	world->status = ISLA_OK;
+	world->pages.entries = NULL;
+	world->cached.entries = NULL;
+	world->cache = ISLA_MALLOC( cache_chunks * sizeof( *world->cache ));
+	if ( world->cache == NULL || isla__map_init( &world->pages, 64 ) != ISLA_OK || isla__map_init( &world->cached, cache_chunks ) != ISLA_OK ) {
+		isla_chunked_destroy( world );
+		return ISLA_ERROR_BAD_ALLOC;
+	}
+	return ISLA_OK;
+}
+
+void isla_chunked_release_pages( isla_chunked *world ) {
+	size_t i;
+	for ( i = 0; i <= world->pages.mask; i++ ) {
+		if ( world->pages.entries[i].key != 0 ) {
+			ISLA_FREE( (isla_chunk_page *) world->pages.entries[i].value );
+		}
+	}
+	isla__map_clear( &world->pages );
+	world->status = ISLA_OK;
+}
+
+void isla_chunked_destroy( isla_chunked *world ) {
+	if ( world->pages.entries != NULL ) {
+		isla_chunked_release_pages( world );
+	}
+	isla__map_destroy( &world->pages );
+	isla__map_destroy( &world->cached );
+	ISLA_FREE( world->cache );
+	world->cache = NULL;
+}
+
+static size_t isla__chunk_key( const isla_chunked *world, int chunk_x, int chunk_y ) {
+	return (size_t) chunk_y * world->chunks_x + chunk_x + 1;
+}
+
+static void isla__chunk_unlink( isla_chunked *world, size_t slot ) {
+	isla_chunk_cache_entry *entry = world->cache + slot;
+	if ( entry->prev != ISLA__CHUNK_NONE ) {
+		world->cache[entry->prev].next = entry->next;
+	} else {
+		world->lru_head = entry->next;
+	}
+	if ( entry->next != ISLA__CHUNK_NONE ) {
+		world->cache[entry->next].prev = entry->prev;
+	} else {
+		world->lru_tail = entry->prev;
+	}
+}
+
+static void isla__chunk_link_front( isla_chunked *world, size_t slot ) {
+	isla_chunk_cache_entry *entry = world->cache + slot;
+	entry->prev = ISLA__CHUNK_NONE;
+	entry->next = world->lru_head;
+	if ( world->lru_head != ISLA__CHUNK_NONE ) {
+		world->cache[world->lru_head].prev = slot;
+	} else {
+		world->lru_tail = slot;
+	}
+	world->lru_head = slot;
+}
+
+// Returns occupancy bits of the chunk, loads it evicting the least recently used one if needed
+static const unsigned char *isla__chunk_occupancy( isla_chunked *world, int chunk_x, int chunk_y ) {
+	size_t key = isla__chunk_key( world, chunk_x, chunk_y );
+	size_t *found;
+	size_t slot;
+	if ( world->lru_head != ISLA__CHUNK_NONE && world->cache[world->lru_head].key == key ) {
+		return world->cache[world->lru_head].blocked;
+	}
+	found = isla__map_get( &world->cached, key );
+	if ( found != NULL ) {
+		slot = *found;
+		isla__chunk_unlink( world, slot );
+	} else {
+		if ( world->cache_used < world->cache_size ) {
+			slot = world->cache_used++;
+		} else {
+			slot = world->lru_tail;
+			isla__chunk_unlink( world, slot );
+			if ( world->cache[slot].key != 0 ) {
+				isla__map_remove( &world->cached, world->cache[slot].key );
+			}
+		}
+		world->cache[slot].key = key;
+		world->loads++;
+		if ( !world->loader( chunk_x, chunk_y, world->cache[slot].blocked, world->loader_data )) {
+			size_t i;
+			for ( i = 0; i < sizeof( world->cache[slot].blocked ); i++ ) {
+				world->cache[slot].blocked[i] = 0xff;
+			}
+		}
+		isla__map_put( &world->cached, key, slot );
+	}
+	isla__chunk_link_front( world, slot );
+	return world->cache[slot].blocked;
+}
+
+void isla_chunked_invalidate( isla_chunked *world, int chunk_x, int chunk_y ) {
+	size_t key = isla__chunk_key( world, chunk_x, chunk_y );
+	size_t *found = isla__map_get( &world->cached, key );
+	if ( found != NULL ) {
+		size_t slot = *found;
+		isla__map_remove( &world->cached, key );
+		isla__chunk_unlink( world, slot );
+		// Slot goes to the tail, so it's reused first
+		world->cache[slot].key = 0;
+		world->cache[slot].next = ISLA__CHUNK_NONE;
+		world->cache[slot].prev = world->lru_tail;
+		if ( world->lru_tail != ISLA__CHUNK_NONE ) {
+			world->cache[world->lru_tail].next = slot;
+		} else {
+			world->lru_head = slot;
+		}
+		world->lru_tail = slot;
+	}
+}
+
+int isla_chunked_is_blocked( isla_chunked *world, int x, int y ) {
+	const unsigned char *blocked;
+	int local;
+	if ( x < 0 || y < 0 || x >= world->width || y >= world->height ) {
+		return 1;
+	}
+	blocked = isla__chunk_occupancy( world, x >> ISLA_CHUNK_BITS, y >> ISLA_CHUNK_BITS );
+	local = ((y & (ISLA_CHUNK_SIZE - 1)) << ISLA_CHUNK_BITS) | (x & (ISLA_CHUNK_SIZE - 1));
+	return (blocked[local >> 3] >> (local & 7)) & 1;
+}
+
+isla_node *isla_chunked_node( isla_chunked *world, int x, int y ) {
+	int chunk_x = x >> ISLA_CHUNK_BITS;
+	int chunk_y = y >> ISLA_CHUNK_BITS;
+	size_t key;
+	size_t *found;
+	isla_chunk_page *page;
+	if ( x < 0 || y < 0 || x >= world->width || y >= world->height ) {
+		return NULL;
+	}
+	key = isla__chunk_key( world, chunk_x, chunk_y );
+	found = isla__map_get( &world->pages, key );
+	if ( found != NULL ) {
+		page = (isla_chunk_page *) *found;
+	} else {
+		size_t i;
+		page = ISLA_MALLOC( sizeof( *page ));
+		if ( page == NULL || isla__map_put( &world->pages, key, (size_t) page ) != ISLA_OK ) {
+			ISLA_FREE( page );
+			world->status = ISLA_ERROR_BAD_ALLOC;
+			return NULL;
+		}
+		page->chunk_x = chunk_x;
+		page->chunk_y = chunk_y;
+		for ( i = 0; i < ISLA_CHUNK_SIZE * ISLA_CHUNK_SIZE; i++ ) {
+			isla__reset_node( page->nodes + i );
+			page->nodes[i].data = page;
+		}
+	}
+	return page->nodes + (((y & (ISLA_CHUNK_SIZE - 1)) << ISLA_CHUNK_BITS) | (x & (ISLA_CHUNK_SIZE - 1)));
+}
+
+void isla_chunked_coords( const isla_chunked *world, const isla_node *node, int *x, int *y ) {
+	const isla_chunk_page *page = node->data;
+	int local = (int) (node - page->nodes);
+	(void) world;
+	*x = (page->chunk_x << ISLA_CHUNK_BITS) + (local & (ISLA_CHUNK_SIZE - 1));
+	*y = (page->chunk_y << ISLA_CHUNK_BITS) + (local >> ISLA_CHUNK_BITS);
+}
+
+isla_node *isla_chunked_next_neighbor( isla_node *node, isla_node *prev, void *userdata ) {
+	static const signed char dx[8] = {1, 0, -1, 0, 1, -1, -1, 1};
+	static const signed char dy[8] = {0, 1, 0, -1, 1, 1, -1, -1};
+	isla_chunked *world = userdata;
+	int directions = world->diagonal ? 8 : 4;
+	int x, y;
+	int dir = 0;
+	isla_chunked_coords( world, node, &x, &y );
+	if ( prev != NULL ) {
+		int px, py;
+		isla_chunked_coords( world, prev, &px, &py );
+		while ( dx[dir] != px - x || dy[dir] != py - y ) {
+			dir++;
+		}
+		dir++;
+	}
+	for ( ; dir < directions; dir++ ) {
+		int nx = x + dx[dir];
+		int ny = y + dy[dir];
+		if ( !isla_chunked_is_blocked( world, nx, ny ) && (dir < 4 || (!isla_chunked_is_blocked( world, nx, y ) && !isla_chunked_is_blocked( world, x, ny )))) {
+			return isla_chunked_node( world, nx, ny );
+		}
+	}
+	return NULL;
+}
+
+isla_cost isla_chunked_eval_cost( isla_node *node1, isla_node *node2, void *userdata ) {
+	int x1, y1, x2, y2;
+	isla_chunked_coords( userdata, node1, &x1, &y1 );
+	isla_chunked_coords( userdata, node2, &x2, &y2 );
+	return (isla_cost) (x1 != x2 && y1 != y2 ? ISLA_GRID_COST_DIAGONAL : ISLA_GRID_COST_STRAIGHT);
+}
+
+isla_cost isla_chunked_estimate_cost( isla_node *node1, isla_node *node2, void *userdata ) {
+	const isla_chunked *world = userdata;
+	int x1, y1, x2, y2;
+	int a, b;
+	isla_chunked_coords( world, node1, &x1, &y1 );
+	isla_chunked_coords( world, node2, &x2, &y2 );
+	a = x1 > x2 ? x1 - x2 : x2 - x1;
+	b = y1 > y2 ? y1 - y2 : y2 - y1;
+	if ( !world->diagonal ) {
+		return (isla_cost) ((a + b) * ISLA_GRID_COST_STRAIGHT);
+	}
+	return a > b ? (isla_cost) (b * ISLA_GRID_COST_DIAGONAL + (a - b) * ISLA_GRID_COST_STRAIGHT) : (isla_cost) (a * ISLA_GRID_COST_DIAGONAL + (b - a) * ISLA_GRID_COST_STRAIGHT);
+}
+
+void isla_chunked_properties( isla_chunked *world, isla_properties *properties ) {
+	properties->next_neighbor = isla_chunked_next_neighbor;
+	properties->eval_cost = isla_chunked_eval_cost;
+	properties->estimate_cost = isla_chunked_estimate_cost;
+	properties->backend_status = &world->status;
+}
+// End of chunked world backend
+
+
+// Implicit graph backend. States are interned by key into open addressing table of node
+// pointers, records (node, hash and key) are carved from fixed size blocks which are never
+// moved, so node pointers stay valid until the graph is cleared.
+typedef struct {
+	isla_node node;
+	size_t hash;
+} isla__implicit_record;
+
+#define ISLA__IMPLICIT_KEY_OFFSET ISLA__ALIGN( sizeof( isla__implicit_record ))
+
+static size_t isla__implicit_hash( const unsigned char *key, size_t key_size ) {
+	size_t hash = (size_t) 2166136261u;
+	size_t i;
+	for ( i = 0; i < key_size; i++ ) {
+		hash = (hash ^ key[i]) * (size_t) 16777619u;
+	}
+	return isla__hash( hash );
+}
+
+static int isla__implicit_equal( const unsigned char *key1, const unsigned char *key2, size_t key_size ) {
+	size_t i;
+	for ( i = 0; i < key_size; i++ ) {
+		if ( key1[i] != key2[i] ) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static isla_status isla__implicit_alloc_table( isla_implicit *graph, size_t capacity ) {
+	size_t i;
+	graph->table = ISLA_MALLOC( capacity * sizeof( *graph->table ));
+	if ( graph->table == NULL ) {
+		return ISLA_ERROR_BAD_ALLOC;
+	}
+	for ( i = 0; i < capacity; i++ ) {
+		graph->table[i] = NULL;
+	}
+	graph->mask = capacity - 1;
+	return ISLA_OK;
+}
+
+isla_status isla_implicit_init( isla_implicit *graph, size_t key_size, size_t expected_states, isla_implicit_successors successors, void *userdata ) {
+	size_t capacity = 16;
+	if ( key_size == 0 ) {
+		return ISLA_ERROR_BAD_ARGUMENTS;
+	}
+	while ( capacity < expected_states * 2 ) {
+		capacity <<= 1;
+	}
+	graph->key_size = key_size;
+	graph->record_size = ISLA__IMPLICIT_KEY_OFFSET + ISLA__ALIGN( key_size );
+	graph->blocks = NULL;
+	graph->blocks_count = 0;
+	graph->blocks_allocated = 0;
+	graph->block_records = expected_states < 1024 ? 1024 : ( expected_states > 65536 ? 65536 : expected_states );
+	graph->block_used = graph->block_records;
+	graph->count = 0;
+	graph->successors = successors;
+	graph->userdata = userdata;
+	graph->expanded = NULL;
+	graph->neighbors_count = 0;
+	graph->cursor = 0;
+	graph->status = ISLA_OK;
+	graph->scratch = ISLA_MALLOC( key_size * ISLA_MAX_NEIGHBORS );
+	if ( graph->scratch == NULL || isla__implicit_alloc_table( graph, capacity ) != ISLA_OK ) {
+		ISLA_FREE( graph->scratch );
+		graph->scratch = NULL;
+		return ISLA_ERROR_BAD_ALLOC;
+	}
+	return ISLA_OK;
+}
+
+void isla_implicit_destroy( isla_implicit *graph ) {
+	size_t i;
+	for ( i = 0; i < graph->blocks_count; i++ ) {
+		ISLA_FREE( graph->blocks[i] );
+	}
+	ISLA_FREE( graph->blocks );
+	ISLA_FREE( graph->table );
+	ISLA_FREE( graph->scratch );
+	graph->blocks = NULL;
+	graph->table = NULL;
+	graph->scratch = NULL;
+	graph->blocks_count = 0;
+	graph->count = 0;
+}
+
+// Forgets all states but keeps blocks and table for the next search
+void isla_implicit_clear( isla_implicit *graph ) {
+	size_t i;
+	for ( i = 0; i <= graph->mask; i++ ) {
+		graph->table[i] = NULL;
+	}
+	graph->count = 0;
+	graph->block_used = graph->blocks_count > 0 ? 0 : graph->block_records;
+	graph->blocks_allocated = graph->blocks_count > 0 ? 1 : 0;
+	graph->expanded = NULL;
+	graph->status = ISLA_OK;
+}
+
+// Returns memory for the next record, blocks_allocated is the number of blocks in use,
+// blocks_count is the number of blocks retained since the last clear
+static isla__implicit_record *isla__implicit_record_alloc( isla_implicit *graph ) {
+	unsigned char *block;
+	if ( graph->block_used >= graph->block_records ) {
+		if ( graph->blocks_allocated >= graph->blocks_count ) {
+			unsigned char **blocks = ISLA_REALLOC( graph->blocks, (graph->blocks_count + 1) * sizeof( *blocks ));
+			if ( blocks == NULL ) {
+				return NULL;
+			}
+			graph->blocks = blocks;
+			graph->blocks[graph->blocks_count] = ISLA_MALLOC( graph->block_records * graph->record_size );
+			if ( graph->blocks[graph->blocks_count] == NULL ) {
+				return NULL;
+			}
+			graph->blocks_count++;
+		}
+		graph->blocks_allocated++;
+		graph->block_used = 0;
+	}
+	block = graph->blocks[graph->blocks_allocated - 1];
+	return (isla__implicit_record *) (block + graph->record_size * graph->block_used++);
+}
+
+static isla_status isla__implicit_grow( isla_implicit *graph ) {
+	isla_node **old = graph->table;
+	size_t old_mask = graph->mask;
+	size_t i;
+	isla_status status = isla__implicit_alloc_table( graph, (old_mask + 1) * 2 );
+	if ( status != ISLA_OK ) {
+		graph->table = old;
+		graph->mask = old_mask;
+		return status;
+	}
+	for ( i = 0; i <= old_mask; i++ ) {
+		if ( old[i] != NULL ) {
+			size_t j = ((isla__implicit_record *) old[i])->hash & graph->mask;
+			while ( graph->table[j] != NULL ) {
+				j = (j + 1) & graph->mask;
+			}
+			graph->table[j] = old[i];
+		}
+	}
+	ISLA_FREE( old );
+	return ISLA_OK;
+}
+
+isla_node *isla_implicit_find( const isla_implicit *graph, const void *key ) {
+	size_t hash = isla__implicit_hash( key, graph->key_size );
+	size_t i = hash & graph->mask;
+	while ( graph->table[i] != NULL ) {
+		isla__implicit_record *record = (isla__implicit_record *) graph->table[i];
+		if ( record->hash == hash && isla__implicit_equal( record->node.data, key, graph->key_size )) {
+			return graph->table[i];
+		}
+		i = (i + 1) & graph->mask;
+	}
+	return NULL;
+}
+
+// Returns node of the state, creating it on the first call. On allocation failure returns
+// NULL and sets sticky graph->status
+isla_node *isla_implicit_node( isla_implicit *graph, const void *key ) {
+	size_t hash = isla__implicit_hash( key, graph->key_size );
+	size_t i = hash & graph->mask;
+	isla__implicit_record *record;
+	unsigned char *record_key;
+	size_t j;
+	while ( graph->table[i] != NULL ) {
+		record = (isla__implicit_record *) graph->table[i];
+		if ( record->hash == hash && isla__implicit_equal( record->node.data, key, graph->key_size )) {
+			return graph->table[i];
+		}
+		i = (i + 1) & graph->mask;
+	}
+	if ( (graph->count + 1) * 2 > graph->mask + 1 ) {
+		if ( isla__implicit_grow( graph ) != ISLA_OK ) {
+			graph->status = ISLA_ERROR_BAD_ALLOC;
+			return NULL;
+		}
+		i = hash & graph->mask;
+		while ( graph->table[i] != NULL ) {
+			i = (i + 1) & graph->mask;
+		}
+	}
+	record = isla__implicit_record_alloc( graph );
+	if ( record == NULL ) {
+		graph->status = ISLA_ERROR_BAD_ALLOC;
+		return NULL;
+	}
+	record_key = (unsigned char *) record + ISLA__IMPLICIT_KEY_OFFSET;
+	for ( j = 0; j < graph->key_size; j++ ) {
+		record_key[j] = ((const unsigned char *) key)[j];
+	}
+	isla__reset_node( &record->node );
+	record->node.data = record_key;
+	record->hash = hash;
+	graph->table[i] = &record->node;
+	graph->count++;
+	return &record->node;
+}
+
+const void *isla_implicit_key( const isla_node *node ) {
+	return node->data;
+}
+
+void isla_implicit_properties( isla_implicit *graph, isla_properties *properties ) {
+	properties->next_neighbor = isla_implicit_next_neighbor;
+	properties->backend_status = &graph->status;
+}
+
+// Successors of the last expanded node are interned once and cached, duplicates are dropped,
+// so prev is found unambiguously even if other nodes were expanded in between (IDA*)
+isla_node *isla_implicit_next_neighbor( isla_node *node, isla_node *prev, void *userdata ) {
+	isla_implicit *graph = userdata;
+	size_t i;
+	if ( node != graph->expanded ) {
+		size_t count = graph->successors( node->data, graph->scratch, graph->userdata );
+		graph->expanded = node;
+		graph->neighbors_count = 0;
+		graph->cursor = 0;
+		for ( i = 0; i < count && i < ISLA_MAX_NEIGHBORS; i++ ) {
+			isla_node *neighbor = isla_implicit_node( graph, graph->scratch + i * graph->key_size );
+			size_t j;
+			if ( neighbor == NULL ) {
+				continue;
+			}
+			for ( j = 0; j < graph->neighbors_count && graph->neighbors[j] != neighbor; j++ );
+			if ( j == graph->neighbors_count ) {
+				graph->neighbors[graph->neighbors_count++] = neighbor;
+			}
+		}
+	}
+	if ( prev == NULL ) {
+		i = 0;
+	} else if ( graph->cursor < graph->neighbors_count && graph->neighbors[graph->cursor] == prev ) {
+		i = graph->cursor + 1;
+	} else {
+		for ( i = 0; i < graph->neighbors_count && graph->neighbors[i] != prev; i++ );
+		i++;
+	}
+	graph->cursor = i;
+	return i < graph->neighbors_count ? graph->neighbors[i] : NULL;
+}
+// End of implicit graph backend
+
+
+// Differential heuristic. Exact distances from a few landmarks are quantized down to 8 or 16
+// bits per node, |d(L,a) - d(L,b)| is a lower bound of d(a,b) in undirected graphs and one
+// quantization step is subtracted to cover rounding of both values.
+#define ISLA__DH_LEVELS(bits) ((size_t) 1 << (bits))
+
+static size_t isla__dh_get( const isla_dh *dh, size_t index, size_t landmark ) {
+	if ( dh->bits == 8 ) {
+		return ((const unsigned char *) dh->data)[index * dh->landmarks + landmark];
+	} else {
+		return ((const unsigned short *) dh->data)[index * dh->landmarks + landmark];
+	}
+}
+
+static void isla__dh_set( isla_dh *dh, size_t index, size_t landmark, size_t value ) {
+	if ( dh->bits == 8 ) {
+		((unsigned char *) dh->data)[index * dh->landmarks + landmark] = (unsigned char) value;
+	} else {
+		((unsigned short *) dh->data)[index * dh->landmarks + landmark] = (unsigned short) value;
+	}
+}
+
+// Plain Dijkstra over idle nodes, reached nodes are left closed with exact g
+static isla_status isla__dh_dijkstra( isla_dh *dh, isla_node *source, isla_path *heap ) {
+	isla_node *node;
+	isla_status status;
+	source->g = 0;
+	source->f = 0;
+	source->status = ISLA_NODE_OPENED;
+	status = isla__heap_enqueue( heap, source );
+	while ( status == ISLA_OK && (node = isla__heap_dequeue( heap )) != NULL ) {
+		isla_node *neighbor = NULL;
+		node->status = ISLA_NODE_CLOSED;
+		while ( status == ISLA_OK && (neighbor = dh->next_neighbor( node, neighbor, dh->userdata ))) {
+			if ( neighbor->status != ISLA_NODE_CLOSED ) {
+				isla_cost g = node->g + dh->eval_cost( node, neighbor, dh->userdata );
+				if ( neighbor->status == ISLA_NODE_DEFAULT || g < neighbor->g ) {
+					neighbor->g = g;
+					neighbor->f = g;
+					if ( neighbor->status == ISLA_NODE_OPENED ) {
+						isla__heap_update( heap, neighbor );
+					} else {
+						neighbor->status = ISLA_NODE_OPENED;
+						status = isla__heap_enqueue( heap, neighbor );
+					}
+				}
+			}
+		}
+	}
+	heap->length = 0;
+	return status;
+}
+
+static void isla__dh_reset( isla_dh *dh ) {
+	size_t i;
+	for ( i = 0; i < dh->count; i++ ) {
+		isla__reset_node( dh->nodes + i );
+	}
+}
+
+// Landmarks are placed farthest-first: the first one is the farthest node from the seed, every
+// next one maximizes the distance to the closest landmark already placed
+isla_status isla_dh_init( isla_dh *dh, isla_node *nodes, size_t count, isla_node *seed, size_t landmarks, int bits, isla_properties *properties, void *userdata ) {
+	isla_status status;
+	isla_path *heap;
+	isla_cost *mindist;
+	isla_node *landmark = NULL;
+	size_t levels = ISLA__DH_LEVELS( bits );
+	size_t i;
+	size_t l;
+
+	if ( nodes == NULL || count == 0 || seed < nodes || seed >= nodes + count || landmarks == 0 || landmarks > ISLA_DH_MAX_LANDMARKS || (bits != 8 && bits != 16) || properties == NULL ) {
+		return ISLA_ERROR_BAD_ARGUMENTS;
+	}
+
+	dh->nodes = nodes;
+	dh->count = count;
+	dh->landmarks = landmarks;
+	dh->bits = bits;
+	dh->next_neighbor = properties->next_neighbor;
+	dh->eval_cost = properties->eval_cost;
+	dh->estimate_cost = properties->estimate_cost;
+	dh->is_finish_node = properties->is_finish_node;
+	dh->userdata = userdata;
+	dh->data = ISLA_MALLOC( count * landmarks * (size_t) (bits / 8));
+	mindist = ISLA_MALLOC( count * sizeof( *mindist ));
+	heap = isla__path_create( ISLA_MAX_NEIGHBORS );
+	if ( dh->data == NULL || mindist == NULL || heap == NULL ) {
+		ISLA_FREE( mindist );
+		isla_destroy_path( heap );
+		isla_dh_destroy( dh );
+		return ISLA_ERROR_BAD_ALLOC;
+	}
+
+	status = isla__dh_dijkstra( dh, seed, heap );
+	for ( i = 0; i < count; i++ ) {
+		if ( nodes[i].status == ISLA_NODE_CLOSED && (landmark == NULL || nodes[i].g > landmark->g )) {
+			landmark = nodes + i;
+		}
+		mindist[i] = 0;
+	}
+	isla__dh_reset( dh );
+
+	for ( l = 0; l < landmarks && status == ISLA_OK; l++ ) {
+		isla_cost maxdist = 0;
+		isla_node *next = NULL;
+		dh->landmark_nodes[l] = landmark;
+		status = isla__dh_dijkstra( dh, landmark, heap );
+		for ( i = 0; i < count; i++ ) {
+			if ( nodes[i].status == ISLA_NODE_CLOSED && nodes[i].g > maxdist ) {
+				maxdist = nodes[i].g;
+			}
+		}
+		// The highest level is reserved for unreachable nodes
+		dh->scales[l] = maxdist / (isla_cost) (levels - 2);
+		if ( dh->scales[l] <= 0 ) {
+			dh->scales[l] = 1;
+		}
+		for ( i = 0; i < count; i++ ) {
+			if ( nodes[i].status == ISLA_NODE_CLOSED ) {
+				size_t q = (size_t) (nodes[i].g / dh->scales[l]);
+				isla__dh_set( dh, i, l, q > levels - 2 ? levels - 2 : q );
+				if ( l == 0 || nodes[i].g < mindist[i] ) {
+					mindist[i] = nodes[i].g;
+				}
+				if ( next == NULL || mindist[i] > mindist[next - nodes] ) {
+					next = nodes + i;
+				}
+			} else {
+				isla__dh_set( dh, i, l, levels - 1 );
+			}
+		}
+		isla__dh_reset( dh );
+		landmark = next;
+	}
+
+	ISLA_FREE( mindist );
+	isla_destroy_path( heap );
+	if ( status != ISLA_OK ) {
+		isla_dh_destroy( dh );
+	}
+	return status;
+}
+
+void isla_dh_destroy( isla_dh *dh ) {
+	ISLA_FREE( dh->data );
+	dh->data = NULL;
+}
+
+size_t isla_dh_memory( const isla_dh *dh ) {
+	return dh->count * dh->landmarks * (size_t) (dh->bits / 8);
+}
+
+void isla_dh_properties( isla_dh *dh, isla_properties *properties ) {
+	properties->next_neighbor = isla_dh_next_neighbor;
+	properties->eval_cost = isla_dh_eval_cost;
+	properties->estimate_cost = isla_dh_estimate_cost;
+	properties->is_finish_node = dh->is_finish_node != NULL ? isla_dh_is_finish_node : NULL;
+	properties->reopen_closed = 1;
+}
+
+isla_node *isla_dh_next_neighbor( isla_node *node, isla_node *prev, void *userdata ) {
+	isla_dh *dh = userdata;
+	return dh->next_neighbor( node, prev, dh->userdata );
+}
+
+isla_cost isla_dh_eval_cost( isla_node *node1, isla_node *node2, void *userdata ) {
+	isla_dh *dh = userdata;
+	return dh->eval_cost( node1, node2, dh->userdata );
+}
+
+int isla_dh_is_finish_node( isla_node *node, void *userdata ) {
+	isla_dh *dh = userdata;
+	return dh->is_finish_node( node, dh->userdata );
+}
+
+// Maximum of the wrapped heuristic and all landmark bounds
+isla_cost isla_dh_estimate_cost( isla_node *node1, isla_node *node2, void *userdata ) {
+	isla_dh *dh = userdata;
+	isla_cost h = dh->estimate_cost != NULL ? dh->estimate_cost( node1, node2, dh->userdata ) : 0;
+	size_t unreachable = ISLA__DH_LEVELS( dh->bits ) - 1;
+	size_t index1 = (size_t) (node1 - dh->nodes);
+	size_t index2 = (size_t) (node2 - dh->nodes);
+	size_t l;
+	if ( index1 >= dh->count || index2 >= dh->count ) {
+		return h;
+	}
+	for ( l = 0; l < dh->landmarks; l++ ) {
+		size_t q1 = isla__dh_get( dh, index1, l );
+		size_t q2 = isla__dh_get( dh, index2, l );
+		size_t delta = q1 > q2 ? q1 - q2 : q2 - q1;
+		if ( q1 != unreachable && q2 != unreachable && delta > 1 ) {
+			isla_cost bound = (isla_cost) (delta - 1) * dh->scales[l];
+			if ( bound > h ) {
+				h = bound;
+			}
+		}
+	}
+	return h;
+}
+// End of differential heuristic
+
+
+// Dead-end regions. Part of the graph attached to the rest through a single articulation node
+// can't be on the shortest path unless start or finish is inside: path would have to enter and
+// leave it through the same node. Articulation nodes are found by iterative Tarjan DFS, subtrees
+// cut off by them are contiguous in DFS order, only outermost ones become regions.
+#define ISLA__DEADEND_NONE ((size_t) -1)
+
+isla_status isla_deadend_init( isla_deadend *de, isla_node *nodes, size_t count, isla_node *seed, isla_properties *properties, void *userdata ) {
+	size_t *disc;
+	size_t *low;
+	size_t *parent;
+	size_t *order;
+	size_t *cut;
+	isla__ida_frame *frames;
+	size_t depth = 1;
+	size_t stamp = 1;
+	size_t root = (size_t) (seed - nodes);
+	size_t largest = ISLA__DEADEND_NONE;
+	size_t end = 0;
+	size_t i;
+
+	if ( nodes == NULL || count == 0 || seed < nodes || seed >= nodes + count || properties == NULL ) {
+		return ISLA_ERROR_BAD_ARGUMENTS;
+	}
+
+	de->nodes = nodes;
+	de->count = count;
+	de->regions_count = 0;
+	de->pruned_nodes = 0;
+	de->next_neighbor = properties->next_neighbor;
+	de->eval_cost = properties->eval_cost;
+	de->estimate_cost = properties->estimate_cost;
+	de->is_finish_node = properties->is_finish_node;
+	de->userdata = userdata;
+	de->regions = ISLA_MALLOC( count * sizeof( *de->regions ));
+	disc = ISLA_MALLOC( count * sizeof( *disc ));
+	low = ISLA_MALLOC( count * sizeof( *low ));
+	parent = ISLA_MALLOC( count * sizeof( *parent ));
+	order = ISLA_MALLOC( (count + 1) * sizeof( *order ));
+	cut = ISLA_MALLOC( (count + 1) * sizeof( *cut ));
+	frames = ISLA_MALLOC( count * sizeof( *frames ));
+	if ( de->regions == NULL || disc == NULL || low == NULL || parent == NULL || order == NULL || cut == NULL || frames == NULL ) {
+		ISLA_FREE( disc );
+		ISLA_FREE( low );
+		ISLA_FREE( parent );
+		ISLA_FREE( order );
+		ISLA_FREE( cut );
+		ISLA_FREE( frames );
+		isla_deadend_destroy( de );
+		return ISLA_ERROR_BAD_ALLOC;
+	}
+	for ( i = 0; i < count; i++ ) {
+		de->regions[i] = 0;
+		disc[i] = ISLA__DEADEND_NONE;
+		cut[i] = 0;
+	}
+	cut[count] = 0;
+
+	// Discovery stamp starts from 1, cut[t] is the size of the separated subtree discovered at t
+	disc[root] = low[root] = 0;
+	parent[root] = ISLA__DEADEND_NONE;
+	order[0] = root;
+	frames[0].node = seed;
+	frames[0].neighbor = NULL;
+	while ( depth > 0 ) {
+		isla__ida_frame *frame = frames + depth - 1;
+		size_t index = (size_t) (frame->node - nodes);
+		isla_node *neighbor = properties->next_neighbor( frame->node, frame->neighbor, userdata );
+		size_t j;
+		frame->neighbor = neighbor;
+		if ( neighbor == NULL ) {
+			depth--;
+			if ( depth > 0 ) {
+				size_t p = parent[index];
+				if ( low[index] < low[p] ) {
+					low[p] = low[index];
+				}
+				if ( low[index] >= disc[p] ) {
+					cut[disc[index]] = stamp - disc[index];
+					if ( p == root && (largest == ISLA__DEADEND_NONE || cut[disc[index]] > cut[disc[largest]] )) {
+						largest = index;
+					}
+				}
+			}
+			continue;
+		}
+		j = (size_t) (neighbor - nodes);
+		if ( j >= count ) {
+			continue;
+		}
+		if ( disc[j] == ISLA__DEADEND_NONE ) {
+			disc[j] = low[j] = stamp;
+			order[stamp++] = j;
+			parent[j] = index;
+			frames[depth].node = neighbor;
+			frames[depth].neighbor = NULL;
+			depth++;
+		} else if ( j != parent[index] && disc[j] < low[index] ) {
+			low[index] = disc[j];
+		}
+	}
+
+	// Seed is expected to be in the main area, so its largest subtree is not a dead end
+	if ( largest != ISLA__DEADEND_NONE ) {
+		cut[disc[largest]] = 0;
+	}
+	for ( i = 1; i < stamp; i++ ) {
+		if ( cut[i] > 0 && i >= end ) {
+			size_t k;
+			de->regions_count++;
+			end = i + cut[i];
+			for ( k = i; k < end; k++ ) {
+				de->regions[order[k]] = de->regions_count;
+			}
+			de->pruned_nodes += cut[i];
+		}
+	}
+
+	ISLA_FREE( disc );
+	ISLA_FREE( low );
+	ISLA_FREE( parent );
+	ISLA_FREE( order );
+	ISLA_FREE( cut );
+	ISLA_FREE( frames );
+	return ISLA_OK;
+}
+
+void isla_deadend_destroy( isla_deadend *de ) {
+	ISLA_FREE( de->regions );
+	de->regions = NULL;
+}
+
+unsigned isla_deadend_region( const isla_deadend *de, const isla_node *node ) {
+	size_t index = (size_t) (node - de->nodes);
+	return index < de->count ? de->regions[index] : 0;
+}
+
+void isla_deadend_properties( isla_deadend *de, isla_properties *properties ) {
+	properties->next_neighbor = isla_deadend_next_neighbor;
+	properties->eval_cost = isla_deadend_eval_cost;
+	properties->estimate_cost = isla_deadend_estimate_cost;
+	properties->is_finish_node = de->is_finish_node != NULL ? isla_deadend_is_finish_node : NULL;
+	properties->prune_neighbor = isla_deadend_prune;
+}
+
+isla_node *isla_deadend_next_neighbor( isla_node *node, isla_node *prev, void *userdata ) {
+	isla_deadend *de = userdata;
+	return de->next_neighbor( node, prev, de->userdata );
+}
+
+isla_cost isla_deadend_eval_cost( isla_node *node1, isla_node *node2, void *userdata ) {
+	isla_deadend *de = userdata;
+	return de->eval_cost( node1, node2, de->userdata );
+}
+
+isla_cost isla_deadend_estimate_cost( isla_node *node1, isla_node *node2, void *userdata ) {
+	isla_deadend *de = userdata;
+	return de->estimate_cost( node1, node2, de->userdata );
+}
+
+int isla_deadend_is_finish_node( isla_node *node, void *userdata ) {
+	isla_deadend *de = userdata;
+	return de->is_finish_node( node, de->userdata );
+}
+
+// Search can be inside a region only if it started there, so moves within the node's own
+// region and into the finish region are allowed
+int isla_deadend_prune( isla_node *node, isla_node *neighbor, isla_node *finish, void *userdata ) {
+	const isla_deadend *de = userdata;
+	unsigned region = isla_deadend_region( de, neighbor );
+	return region != 0 && region != isla_deadend_region( de, node ) && region != isla_deadend_region( de, finish );
+}
+// End of dead-end regions
+
+
+// All-pairs shortest paths for small graphs by blocked Floyd-Warshall. Matrices are row-major,
+// blocks of ISLA_APSP_BLOCK rows and columns are updated in three phases per diagonal block so
+// they stay in cache, the innermost loop is a branchless min-plus over contiguous rows which
+// compilers vectorize. Infinity is one more than the sum of all edge costs, so it's correct
+// for integer costs too.
+#define ISLA__APSP_NO_CELL ((size_t) -1)
+
+static void isla__apsp_kernel( isla_apsp *apsp, size_t ib, size_t jb, size_t kb ) {
+	size_t n = apsp->count;
+	size_t iend = ib + ISLA_APSP_BLOCK < n ? ib + ISLA_APSP_BLOCK : n;
+	size_t jend = jb + ISLA_APSP_BLOCK < n ? jb + ISLA_APSP_BLOCK : n;
+	size_t kend = kb + ISLA_APSP_BLOCK < n ? kb + ISLA_APSP_BLOCK : n;
+	size_t i, j, k;
+	for ( k = kb; k < kend; k++ ) {
+		const isla_cost *dk = apsp->dist + k * n;
+		for ( i = ib; i < iend; i++ ) {
+			isla_cost *di = apsp->dist + i * n;
+			unsigned *ni = apsp->next + i * n;
+			isla_cost dik = di[k];
+			unsigned nik = ni[k];
+			if ( nik == ISLA_APSP_NONE ) {
+				continue;
+			}
+			for ( j = jb; j < jend; j++ ) {
+				isla_cost d = dik + dk[j];
+				int better = d < di[j];
+				di[j] = better ? d : di[j];
+				ni[j] = better ? nik : ni[j];
+			}
+		}
+	}
+}
+
+isla_status isla_apsp_init( isla_apsp *apsp, isla_node *nodes, size_t count, isla_properties *properties, void *userdata ) {
+	size_t i, j;
+	size_t kb, b;
+
+	if ( nodes == NULL || count == 0 || count >= ISLA_APSP_NONE || properties == NULL ) {
+		return ISLA_ERROR_BAD_ARGUMENTS;
+	}
+
+	apsp->nodes = nodes;
+	apsp->count = count;
+	apsp->dist = ISLA_MALLOC( count * count * sizeof( *apsp->dist ));
+	apsp->next = ISLA_MALLOC( count * count * sizeof( *apsp->next ));
+	if ( apsp->dist == NULL || apsp->next == NULL ) {
+		isla_apsp_destroy( apsp );
+		return ISLA_ERROR_BAD_ALLOC;
+	}
+
+	apsp->infinity = 1;
+	for ( i = 0; i < count * count; i++ ) {
+		apsp->next[i] = ISLA_APSP_NONE;
+	}
+	for ( i = 0; i < count; i++ ) {
+		isla_node *neighbor = NULL;
+		apsp->next[i * count + i] = (unsigned) i;
+		while ( (neighbor = properties->next_neighbor( nodes + i, neighbor, userdata ))) {
+			j = (size_t) (neighbor - nodes);
+			if ( j < count && j != i ) {
+				isla_cost cost = properties->eval_cost( nodes + i, neighbor, userdata );
+				apsp->infinity += cost;
+				if ( apsp->next[i * count + j] == ISLA_APSP_NONE || cost < apsp->dist[i * count + j] ) {
+					apsp->dist[i * count + j] = cost;
+					apsp->next[i * count + j] = (unsigned) j;
+				}
+			}
+		}
+	}
+	for ( i = 0; i < count * count; i++ ) {
+		if ( apsp->next[i] == ISLA_APSP_NONE ) {
+			apsp->dist[i] = apsp->infinity;
+		} else if ( i % (count + 1) == 0 ) {
+			apsp->dist[i] = 0;
+		}
+	}
+
+	// Diagonal block first, then its row and column, then all the rest
+	for ( kb = 0; kb < count; kb += ISLA_APSP_BLOCK ) {
+		isla__apsp_kernel( apsp, kb, kb, kb );
+		for ( b = 0; b < count; b += ISLA_APSP_BLOCK ) {
+			if ( b != kb ) {
+				isla__apsp_kernel( apsp, kb, b, kb );
+				isla__apsp_kernel( apsp, b, kb, kb );
+			}
+		}
+		for ( i = 0; i < count; i += ISLA_APSP_BLOCK ) {
+			for ( j = 0; j < count; j += ISLA_APSP_BLOCK ) {
+				if ( i != kb && j != kb ) {
+					isla__apsp_kernel( apsp, i, j, kb );
+				}
+			}
+		}
+	}
+	return ISLA_OK;
+}
+
+void isla_apsp_destroy( isla_apsp *apsp ) {
+	ISLA_FREE( apsp->dist );
+	ISLA_FREE( apsp->next );
+	apsp->dist = NULL;
+	apsp->next = NULL;
+}
+
+static size_t isla__apsp_cell( const isla_apsp *apsp, isla_node *start, isla_node *finish ) {
+	size_t i = (size_t) (start - apsp->nodes);
+	size_t j = (size_t) (finish - apsp->nodes);
+	return i < apsp->count && j < apsp->count ? i * apsp->count + j : ISLA__APSP_NO_CELL;
+}
+
+int isla_apsp_reachable( const isla_apsp *apsp, isla_node *start, isla_node *finish ) {
+	size_t cell = isla__apsp_cell( apsp, start, finish );
+	return cell != ISLA__APSP_NO_CELL && apsp->next[cell] != ISLA_APSP_NONE;
+}
+
+isla_cost isla_apsp_distance( const isla_apsp *apsp, isla_node *start, isla_node *finish ) {
+	size_t cell = isla__apsp_cell( apsp, start, finish );
+	return cell != ISLA__APSP_NO_CELL ? apsp->dist[cell] : apsp->infinity;
+}
+
+isla_node *isla_apsp_next_hop( const isla_apsp *apsp, isla_node *start, isla_node *finish ) {
+	size_t cell = isla__apsp_cell( apsp, start, finish );
+	return cell != ISLA__APSP_NO_CELL && apsp->next[cell] != ISLA_APSP_NONE ? apsp->nodes + apsp->next[cell] : NULL;
+}
+
+// Follows next hops, path is reversed like the one of isla_find_path
+isla_result isla_apsp_path( const isla_apsp *apsp, isla_node *start, isla_node *finish ) {
+	isla_result result = {ISLA_OK,NULL};
+	size_t cell = isla__apsp_cell( apsp, start, finish );
+	size_t j = (size_t) (finish - apsp->nodes);
+	size_t i;
+	if ( cell == ISLA__APSP_NO_CELL ) {
+		result.status = ISLA_ERROR_BAD_ARGUMENTS;
+		return result;
+	}
+	if ( apsp->next[cell] == ISLA_APSP_NONE ) {
+		result.status = ISLA_BLOCKED;
+		return result;
+	}
+	result.path = isla__path_create( 16 );
+	if ( result.path == NULL ) {
+		result.status = ISLA_ERROR_BAD_ALLOC;
+		return result;
+	}
+	i = (size_t) (start - apsp->nodes);
+	result.status = isla__path_push( result.path, start );
+	while ( i != j && result.status == ISLA_OK ) {
+		i = apsp->next[i * apsp->count + j];
+		result.status = isla__path_push( result.path, apsp->nodes + i );
+	}
+	if ( result.status != ISLA_OK ) {
+		isla_destroy_path( result.path );
+		result.path = NULL;
+	} else {
+		isla_reverse_path( result.path );
+	}
+	return result;
+}
+// End of all-pairs shortest paths
+
+
+#ifndef ISLA_NO_STDIO
+// External-memory breadth-first search with delayed duplicate detection. Every layer is a file
+// of sorted unique keys. Successors of the layer are collected in memory, sorted and spilled
+// as runs, then runs are merged while duplicates and keys of previous layers are dropped. Disk
+// is accessed only sequentially through stdio buffers, layer files are kept until the end to
+// restore the path by backward scan.
+typedef struct {
+	FILE *file;
+	char *name;
+	unsigned char *key;
+	int valid;
+	unsigned level;
+} isla__xfile;
+
+typedef struct {
+	isla_external *external;
+	isla_implicit *graph;
+	size_t key_size;
+	unsigned long token;
+	size_t serial;
+	isla__xfile *layers;
+	size_t layers_count;
+	isla__xfile *runs;
+	size_t runs_count;
+	size_t max_runs;
+	isla__xfile **heads;
+	size_t heads_count;
+	isla__xfile closed;
+	unsigned char *buffer;
+	size_t buffered;
+	unsigned char *last;
+} isla__xsearch;
+
+static int isla__key_compare( const unsigned char *key1, const unsigned char *key2, size_t key_size ) {
+	size_t i;
+	for ( i = 0; i < key_size; i++ ) {
+		if ( key1[i] != key2[i] ) {
+			return key1[i] < key2[i] ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+static void isla__key_copy( unsigned char *dst, const unsigned char *src, size_t key_size ) {
+	size_t i;
+	for ( i = 0; i < key_size; i++ ) {
+		dst[i] = src[i];
+	}
+}
+
+static void isla__key_swap( unsigned char *key1, unsigned char *key2, size_t key_size ) {
+	size_t i;
+	for ( i = 0; i < key_size; i++ ) {
+		unsigned char tmp = key1[i];
+		key1[i] = key2[i];
+		key2[i] = tmp;
+	}
+}
+
+// Heapsort, runs are sorted in place without extra memory
+static void isla__keys_siftdown( unsigned char *keys, size_t index, size_t count, size_t key_size ) {
+	size_t child;
+	while ( (child = (index << 1) + 1) < count ) {
+		if ( child + 1 < count && isla__key_compare( keys + child * key_size, keys + (child + 1) * key_size, key_size ) < 0 ) {
+			child++;
+		}
+		if ( isla__key_compare( keys + index * key_size, keys + child * key_size, key_size ) >= 0 ) {
+			break;
+		}
+		isla__key_swap( keys + index * key_size, keys + child * key_size, key_size );
+		index = child;
+	}
+}
+
+static void isla__keys_sort( unsigned char *keys, size_t count, size_t key_size ) {
+	size_t i;
+	for ( i = count / 2; i-- > 0; ) {
+		isla__keys_siftdown( keys, i, count, key_size );
+	}
+	for ( i = count; i-- > 1; ) {
+		isla__key_swap( keys, keys + i * key_size, key_size );
+		isla__keys_siftdown( keys, 0, i, key_size );
+	}
+}
+
+#define ISLA__XFILE_ATTEMPTS 16
+
+// File names carry pid and a token of the search, so concurrent searches of one or many
+// processes sharing the directory don't clash even if stack addresses are reused
+static unsigned long isla__xsearch_token( isla__xsearch *xs ) {
+	unsigned long long h = 14695981039346656037ull;
+	unsigned long long parts[3];
+	size_t i;
+	parts[0] = (unsigned long long) (size_t) xs;
+	parts[1] = (unsigned long long) time( NULL );
+	parts[2] = (unsigned long long) clock();
+	for ( i = 0; i < 3; i++ ) {
+		h = (h ^ parts[i]) * 1099511628211ull;
+		h ^= h >> 29;
+	}
+	return (unsigned long) (h & 0xffffffffu);
+}
+
+static isla_status isla__xfile_open( isla__xsearch *xs, isla__xfile *xf ) {
+	isla_external *external = xs->external;
+	size_t attempt;
+	xf->file = NULL;
+	xf->name = NULL;
+	xf->valid = 0;
+	xf->level = 0;
+	xf->key = ISLA_MALLOC( xs->key_size );
+	if ( xf->key == NULL ) {
+		return ISLA_ERROR_BAD_ALLOC;
+	}
+	if ( external->directory != NULL ) {
+		size_t length = 0;
+		while ( external->directory[length] != '\0' ) {
+			length++;
+		}
+		xf->name = ISLA_MALLOC( length + 96 );
+		if ( xf->name == NULL ) {
+			return ISLA_ERROR_BAD_ALLOC;
+		}
+		// Exclusive create, name taken by another process or search is skipped
+		for ( attempt = 0; attempt < ISLA__XFILE_ATTEMPTS && xf->file == NULL; attempt++ ) {
+			sprintf( xf->name, "%s/isla_%lu_%08lx_%lu.bin", external->directory, ISLA__GETPID(), xs->token, (unsigned long) xs->serial++ );
+			xf->file = fopen( xf->name, "w+bx" );
+		}
+	} else {
+		xf->file = tmpfile();
+	}
+	if ( xf->file == NULL ) {
+		return ISLA_ERROR_IO;
+	}
+	if ( external->io_buffer > 0 ) {
+		setvbuf( xf->file, NULL, _IOFBF, external->io_buffer );
+	}
+	return ISLA_OK;
+}
+
+static void isla__xfile_close( isla__xfile *xf ) {
+	if ( xf->file != NULL ) {
+		fclose( xf->file );
+		if ( xf->name != NULL ) {
+			remove( xf->name );
+		}
+	}
+	ISLA_FREE( xf->name );
+	ISLA_FREE( xf->key );
+	xf->file = NULL;
+	xf->name = NULL;
+	xf->key = NULL;
+	xf->valid = 0;
+}
+
+static int isla__xfile_next( isla__xsearch *xs, isla__xfile *xf ) {
+	xf->valid = fread( xf->key, xs->key_size, 1, xf->file ) == 1;
+	return xf->valid;
+}
+
+static int isla__xfile_rewind( isla__xsearch *xs, isla__xfile *xf ) {
+	rewind( xf->file );
+	return isla__xfile_next( xs, xf );
+}
+
+static isla_status isla__xfile_write( isla__xsearch *xs, isla__xfile *xf, const unsigned char *key ) {
+	if ( fwrite( key, xs->key_size, 1, xf->file ) != 1 ) {
+		return ISLA_ERROR_IO;
+	}
+	xs->external->bytes_written += xs->key_size;
+	return ISLA_OK;
+}
+
+// Heap of run heads, the run with the smallest current key is on top
+static void isla__xheads_siftdown( isla__xsearch *xs, size_t index ) {
+	isla__xfile **heads = xs->heads;
+	size_t count = xs->heads_count;
+	size_t child;
+	while ( (child = (index << 1) + 1) < count ) {
+		isla__xfile *tmp;
+		if ( child + 1 < count && isla__key_compare( heads[child + 1]->key, heads[child]->key, xs->key_size ) < 0 ) {
+			child++;
+		}
+		if ( isla__key_compare( heads[index]->key, heads[child]->key, xs->key_size ) <= 0 ) {
+			break;
+		}
+		tmp = heads[index];
+		heads[index] = heads[child];
+		heads[child] = tmp;
+		index = child;
+	}
+}
+
+static void isla__xheads_init( isla__xsearch *xs, size_t first ) {
+	size_t i;
+	xs->heads_count = 0;
+	for ( i = first; i < xs->runs_count; i++ ) {
+		if ( isla__xfile_rewind( xs, xs->runs + i )) {
+			xs->heads[xs->heads_count++] = xs->runs + i;
+		}
+	}
+	for ( i = xs->heads_count / 2; i-- > 0; ) {
+		isla__xheads_siftdown( xs, i );
+	}
+}
+
+// Advances the top run, exhausted run leaves the heap
+static void isla__xheads_next( isla__xsearch *xs ) {
+	if ( !isla__xfile_next( xs, xs->heads[0] )) {
+		xs->heads[0] = xs->heads[--xs->heads_count];
+	}
+	if ( xs->heads_count > 0 ) {
+		isla__xheads_siftdown( xs, 0 );
+	}
+}
+
+static isla_status isla__xruns_error( isla__xsearch *xs, size_t first ) {
+	size_t i;
+	for ( i = first; i < xs->runs_count; i++ ) {
+		if ( ferror( xs->runs[i].file )) {
+			return ISLA_ERROR_IO;
+		}
+	}
+	return ISLA_OK;
+}
+
+// Merges trailing runs of the same level into one run of the next level, so the number of
+// open runs stays bounded and every key is rewritten about log(runs) / log(fan-in) times.
+// Runs are kept ordered by non-increasing level, lone trailing run is merged with previous.
+static isla_status isla__xsearch_compact( isla__xsearch *xs ) {
+	size_t key_size = xs->key_size;
+	size_t last = xs->runs_count - 1;
+	size_t first = last;
+	isla__xfile merged;
+	isla_status status;
+	int has_last = 0;
+	size_t i;
+	while ( first > 0 && xs->runs[first - 1].level == xs->runs[last].level ) {
+		first--;
+	}
+	if ( first == last ) {
+		first--;
+	}
+	status = isla__xfile_open( xs, &merged );
+	isla__xheads_init( xs, first );
+	while ( status == ISLA_OK && xs->heads_count > 0 ) {
+		isla__xfile *min = xs->heads[0];
+		if ( !has_last || isla__key_compare( min->key, xs->last, key_size ) != 0 ) {
+			isla__key_copy( xs->last, min->key, key_size );
+			has_last = 1;
+			status = isla__xfile_write( xs, &merged, xs->last );
+		}
+		isla__xheads_next( xs );
+	}
+	if ( status == ISLA_OK ) {
+		status = isla__xruns_error( xs, first );
+	}
+	if ( status != ISLA_OK ) {
+		isla__xfile_close( &merged );
+		return status;
+	}
+	merged.level = xs->runs[first].level + (xs->runs[first].level == xs->runs[last].level);
+	for ( i = first; i < xs->runs_count; i++ ) {
+		isla__xfile_close( xs->runs + i );
+	}
+	xs->runs[first] = merged;
+	xs->runs_count = first + 1;
+	return ISLA_OK;
+}
+
+static isla_status isla__xsearch_spill( isla__xsearch *xs ) {
+	size_t key_size = xs->key_size;
+	isla__xfile *run;
+	isla_status status;
+	size_t i;
+	if ( xs->runs_count >= xs->max_runs ) {
+		status = isla__xsearch_compact( xs );
+		if ( status != ISLA_OK ) {
+			return status;
+		}
+	}
+	run = xs->runs + xs->runs_count++;
+	status = isla__xfile_open( xs, run );
+	if ( status != ISLA_OK ) {
+		return status;
+	}
+	// Duplicates inside the run are dropped right away, they are common in BFS layers
+	isla__keys_sort( xs->buffer, xs->buffered, key_size );
+	for ( i = 0; i < xs->buffered && status == ISLA_OK; i++ ) {
+		if ( i == 0 || isla__key_compare( xs->buffer + (i - 1) * key_size, xs->buffer + i * key_size, key_size ) != 0 ) {
+			status = isla__xfile_write( xs, run, xs->buffer + i * key_size );
+		}
+	}
+	xs->buffered = 0;
+	return status;
+}
+
+static isla_status isla__xsearch_expand( isla__xsearch *xs, isla__xfile *layer ) {
+	isla_implicit *graph = xs->graph;
+	size_t key_size = xs->key_size;
+	isla_status status = ISLA_OK;
+	isla__xfile_rewind( xs, layer );
+	while ( layer->valid && status == ISLA_OK ) {
+		size_t count = graph->successors( layer->key, graph->scratch, graph->userdata );
+		size_t i;
+		xs->external->expanded++;
+		for ( i = 0; i < count && i < ISLA_MAX_NEIGHBORS && status == ISLA_OK; i++ ) {
+			isla__key_copy( xs->buffer + xs->buffered * key_size, graph->scratch + i * key_size, key_size );
+			if ( ++xs->buffered >= xs->external->buffer_states ) {
+				status = isla__xsearch_spill( xs );
+			}
+		}
+		isla__xfile_next( xs, layer );
+	}
+	if ( status == ISLA_OK && ferror( layer->file )) {
+		status = ISLA_ERROR_IO;
+	}
+	if ( status == ISLA_OK && xs->buffered > 0 ) {
+		status = isla__xsearch_spill( xs );
+	}
+	return status;
+}
+
+static int isla__xfile_contains( isla__xsearch *xs, isla__xfile *xf, const unsigned char *key ) {
+	while ( xf->valid && isla__key_compare( xf->key, key, xs->key_size ) < 0 ) {
+		isla__xfile_next( xs, xf );
+	}
+	return xf->valid && isla__key_compare( xf->key, key, xs->key_size ) == 0;
+}
+
+// Merges runs into the next layer, keys found in subtracted files (sorted, scanned along
+// with runs) are already visited. Sets found and stops early when the finish is written.
+static isla_status isla__xsearch_merge( isla__xsearch *xs, isla__xfile *subtract, size_t subtract_count, isla__xfile *layer, const unsigned char *finish, int *found ) {
+	size_t key_size = xs->key_size;
+	int has_last = 0;
+	size_t i;
+	isla__xheads_init( xs, 0 );
+	for ( i = 0; i < subtract_count; i++ ) {
+		isla__xfile_rewind( xs, subtract + i );
+	}
+	while ( !*found && xs->heads_count > 0 ) {
+		isla__xfile *min = xs->heads[0];
+		if ( !has_last || isla__key_compare( min->key, xs->last, key_size ) != 0 ) {
+			int duplicate = 0;
+			isla__key_copy( xs->last, min->key, key_size );
+			has_last = 1;
+			for ( i = 0; i < subtract_count && !duplicate; i++ ) {
+				duplicate = isla__xfile_contains( xs, subtract + i, xs->last );
+			}
+			if ( !duplicate ) {
+				isla_status status = isla__xfile_write( xs, layer, xs->last );
+				if ( status != ISLA_OK ) {
+					return status;
+				}
+				*found = isla__key_compare( xs->last, finish, key_size ) == 0;
+			}
+		}
+		isla__xheads_next( xs );
+	}
+	return isla__xruns_error( xs, 0 );
+}
+
+// Keeps the union of all layers when locality is unlimited, layers are disjoint
+static isla_status isla__xsearch_close_layer( isla__xsearch *xs, isla__xfile *layer ) {
+	isla__xfile closed;
+	isla_status status = isla__xfile_open( xs, &closed );
+	isla__xfile_rewind( xs, &xs->closed );
+	isla__xfile_rewind( xs, layer );
+	while ( status == ISLA_OK && (xs->closed.valid || layer->valid )) {
+		isla__xfile *min = !layer->valid || (xs->closed.valid && isla__key_compare( xs->closed.key, layer->key, xs->key_size ) < 0 ) ? &xs->closed : layer;
+		status = isla__xfile_write( xs, &closed, min->key );
+		isla__xfile_next( xs, min );
+	}
+	isla__xfile_close( &xs->closed );
+	xs->closed = closed;
+	return status;
+}
+
+// Walks layers backward, predecessor is any state of the previous layer which generates the
+// current one, then interns the keys into the graph
+static isla_result isla__xsearch_path( isla__xsearch *xs, size_t depth ) {
+	isla_implicit *graph = xs->graph;
+	size_t key_size = xs->key_size;
+	isla_result result = {ISLA_OK, isla__path_create( depth + 1 )};
+	if ( result.path == NULL ) {
+		result.status = ISLA_ERROR_BAD_ALLOC;
+		return result;
+	}
+	for ( ;; ) {
+		isla_node *node = isla_implicit_node( graph, xs->last );
+		int found = 0;
+		if ( node == NULL ) {
+			result.status = ISLA_ERROR_BAD_ALLOC;
+			break;
+		}
+		result.status = isla__path_push( result.path, node );
+		if ( result.status != ISLA_OK || depth == 0 ) {
+			break;
+		}
+		depth--;
+		isla__xfile_rewind( xs, xs->layers + depth );
+		while ( xs->layers[depth].valid && !found ) {
+			size_t count = graph->successors( xs->layers[depth].key, graph->scratch, graph->userdata );
+			size_t i;
+			for ( i = 0; i < count && i < ISLA_MAX_NEIGHBORS && !found; i++ ) {
+				found = isla__key_compare( graph->scratch + i * key_size, xs->last, key_size ) == 0;
+			}
+			if ( !found ) {
+				isla__xfile_next( xs, xs->layers + depth );
+			}
+		}
+		if ( !found ) {
+			result.status = ISLA_ERROR_IO;
+			break;
+		}
+		isla__key_copy( xs->last, xs->layers[depth].key, key_size );
+	}
+	if ( result.status != ISLA_OK ) {
+		isla_destroy_path( result.path );
+		result.path = NULL;
+	}
+	return result;
+}
+
+isla_result isla_find_path_external( isla_implicit *graph, const void *start, const void *finish, isla_external *external ) {
+	isla_result result = {ISLA_OK,NULL};
+	isla__xsearch xs;
+	size_t layers_allocated = 16;
+	size_t max_open_runs;
+	size_t depth = 0;
+	int found;
+	size_t i;
+
+	if ( graph == NULL || start == NULL || finish == NULL || external == NULL || external->buffer_states == 0 ) {
+		result.status = ISLA_ERROR_BAD_ARGUMENTS;
+		return result;
+	}
+	// Merge of all runs needs one more file for its output
+	max_open_runs = external->max_open_runs > 0 ? external->max_open_runs : ISLA_EXTERNAL_MAX_OPEN_RUNS;
+	if ( max_open_runs < 3 || max_open_runs > ((size_t) -1) / sizeof( *xs.runs )) {
+		result.status = ISLA_ERROR_BAD_ARGUMENTS;
+		return result;
+	}
+
+	external->expanded = 0;
+	external->depth = 0;
+	external->bytes_written = 0;
+	xs.external = external;
+	xs.graph = graph;
+	xs.key_size = graph->key_size;
+	xs.token = isla__xsearch_token( &xs );
+	xs.serial = 0;
+	xs.layers_count = 0;
+	xs.runs_count = 0;
+	xs.max_runs = max_open_runs - 1;
+	xs.heads_count = 0;
+	xs.closed.file = NULL;
+	xs.closed.name = NULL;
+	xs.closed.key = NULL;
+	xs.buffered = 0;
+	xs.layers = ISLA_MALLOC( layers_allocated * sizeof( *xs.layers ));
+	xs.buffer = ISLA_MALLOC( external->buffer_states * xs.key_size );
+	xs.last = ISLA_MALLOC( xs.key_size );
+	xs.runs = ISLA_MALLOC( xs.max_runs * sizeof( *xs.runs ));
+	xs.heads = ISLA_MALLOC( xs.max_runs * sizeof( *xs.heads ));
+	if ( xs.layers == NULL || xs.buffer == NULL || xs.last == NULL || xs.runs == NULL || xs.heads == NULL ) {
+		result.status = ISLA_ERROR_BAD_ALLOC;
+	}
+
+	if ( result.status == ISLA_OK ) {
+		xs.layers_count = 1;
+		result.status = isla__xfile_open( &xs, xs.layers );
+		if ( result.status == ISLA_OK ) {
+			result.status = isla__xfile_write( &xs, xs.layers, start );
+		}
+		if ( result.status == ISLA_OK && external->locality == 0 ) {
+			result.status = isla__xfile_open( &xs, &xs.closed );
+			if ( result.status == ISLA_OK ) {
+				result.status = isla__xfile_write( &xs, &xs.closed, start );
+			}
+		}
+	}
+
+	found = isla__key_compare( start, finish, xs.key_size ) == 0;
+	while ( result.status == ISLA_OK && !found ) {
+		isla__xfile *layer;
+		size_t first;
+		if ( external->max_depth > 0 && depth >= external->max_depth ) {
+			result.status = ISLA_LIMIT_REACHED;
+			break;
+		}
+		if ( xs.layers_count >= layers_allocated ) {
+			isla__xfile *layers = ISLA_REALLOC( xs.layers, layers_allocated * 2 * sizeof( *layers ));
+			if ( layers == NULL ) {
+				result.status = ISLA_ERROR_BAD_REALLOC;
+				break;
+			}
+			xs.layers = layers;
+			layers_allocated *= 2;
+		}
+		result.status = isla__xsearch_expand( &xs, xs.layers + depth );
+		if ( result.status != ISLA_OK ) {
+			break;
+		}
+		layer = xs.layers + xs.layers_count++;
+		result.status = isla__xfile_open( &xs, layer );
+		if ( result.status != ISLA_OK ) {
+			break;
+		}
+		// Previous locality layers are enough to detect duplicates in undirected graphs (2)
+		// or graphs with short cycles, otherwise subtract the union of all layers
+		first = depth + 1 > external->locality ? depth + 1 - external->locality : 0;
+		if ( external->locality == 0 ) {
+			result.status = isla__xsearch_merge( &xs, &xs.closed, 1, layer, finish, &found );
+		} else {
+			result.status = isla__xsearch_merge( &xs, xs.layers + first, depth + 1 - first, layer, finish, &found );
+		}
+		for ( i = 0; i < xs.runs_count; i++ ) {
+			isla__xfile_close( xs.runs + i );
+		}
+		xs.runs_count = 0;
+		if ( result.status != ISLA_OK ) {
+			break;
+		}
+		fflush( layer->file );
+		depth++;
+		if ( !found ) {
+			if ( !isla__xfile_rewind( &xs, layer )) {
+				result.status = ferror( layer->file ) ? ISLA_ERROR_IO : ISLA_BLOCKED;
+			} else if ( external->locality == 0 ) {
+				result.status = isla__xsearch_close_layer( &xs, layer );
+			}
+		}
+	}
+
+	external->depth = depth;
+	if ( result.status == ISLA_OK ) {
+		isla__key_copy( xs.last, finish, xs.key_size );
+		result = isla__xsearch_path( &xs, depth );
+	}
+
+	for ( i = 0; i < xs.runs_count; i++ ) {
+		isla__xfile_close( xs.runs + i );
+	}
+	for ( i = 0; i < xs.layers_count; i++ ) {
+		isla__xfile_close( xs.layers + i );
+	}
+	if ( xs.closed.key != NULL ) {
+		isla__xfile_close( &xs.closed );
+	}
+	ISLA_FREE( xs.runs );
+	ISLA_FREE( xs.heads );
+	ISLA_FREE( xs.layers );
+	ISLA_FREE( xs.buffer );
+	ISLA_FREE( xs.last );
+	return result;
+}
+#endif
+// End of external-memory search
+
+
 const char *isla_strstatus( isla_status status ) {
 	const char *statuses[] = {
 		"OK",
@@ -385,6 +5508,10 @@ const char *isla_strstatus( isla_status status ) {
 		"ERROR_BAD_ALLOC",
 		"ERROR_BAD_REALLOC",
 		"ERROR_BAD_ARGUMENTS",
+		"LIMIT_REACHED",
+		"IN_PROGRESS",
+		"CANCELLED",
+		"ERROR_IO",
 	};
 	return statuses[status];
 }
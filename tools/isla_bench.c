@@ -0,0 +1,250 @@
+/*
+ isla_bench - memory-bound search benchmark for isl_astar.h build options
+
+ Generates a map much larger than cache and solves random long queries on it, reporting
+ queries and expansions per second. Build options like ISLA_PREFETCH are compared by
+ building the tool twice and running both binaries with the same arguments.
+
+ Build: cc -O2 -o isla_bench tools/isla_bench.c -lm
+        cc -O2 -DISLA_PREFETCH -o isla_bench_prefetch tools/isla_bench.c -lm
+
+ Usage: isla_bench [-m grid|graph] [-w width] [-d density] [-q queries] [-s seed]
+
+ Grid map is isla_grid of width x width 8-connected cells with density percent of random
+ walls, its nodes lie in memory in scan order. Graph map is the same 8-connected lattice
+ stored as explicit graph whose nodes are shuffled in memory, like a road network loaded
+ in arbitrary order, so nearly every neighbor access misses cache.
+*/
+
+#define ISL_ASTAR_IMPLEMENTATION
+#include "../isl_astar.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define BENCH_DEGREE 8
+
+// Coordinates are kept next to the node, so prefetch of the node brings them too
+typedef struct {
+	isla_node node;
+	int x;
+	int y;
+} Cell;
+
+typedef struct {
+	int width;
+	Cell *nodes;
+	unsigned *neighbors;
+	isla_cost *costs;
+	unsigned char *degree;
+	unsigned *cell;
+} Graph;
+
+static unsigned long long rng_state = 1;
+
+static unsigned rng_next( void ) {
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return (unsigned) (rng_state >> 16);
+}
+
+static double now( void ) {
+	return (double) clock() / CLOCKS_PER_SEC;
+}
+
+static isla_node *graph_neighbor( isla_node *node, isla_node *prev, void *userdata ) {
+	Graph *graph = userdata;
+	size_t index = (size_t) ((Cell *) node - graph->nodes);
+	const unsigned *neighbors = graph->neighbors + index * BENCH_DEGREE;
+	unsigned i = 0;
+	if ( prev != NULL ) {
+		while ( &graph->nodes[neighbors[i]].node != prev ) {
+			i++;
+		}
+		i++;
+	}
+	return i < graph->degree[index] ? &graph->nodes[neighbors[i]].node : NULL;
+}
+
+static isla_cost graph_cost( isla_node *node1, isla_node *node2, void *userdata ) {
+	Graph *graph = userdata;
+	size_t index = (size_t) ((Cell *) node1 - graph->nodes);
+	const unsigned *neighbors = graph->neighbors + index * BENCH_DEGREE;
+	unsigned i = 0;
+	while ( &graph->nodes[neighbors[i]].node != node2 ) {
+		i++;
+	}
+	return graph->costs[index * BENCH_DEGREE + i];
+}
+
+static isla_cost graph_estimate( isla_node *node1, isla_node *node2, void *userdata ) {
+	int dx = abs( ((Cell *) node1)->x - ((Cell *) node2)->x );
+	int dy = abs( ((Cell *) node1)->y - ((Cell *) node2)->y );
+	(void) userdata;
+	return dx > dy ? (dx - dy) + dy * ISLA_GRID_COST_DIAGONAL : (dy - dx) + dx * ISLA_GRID_COST_DIAGONAL;
+}
+
+// Lattice cells are mapped to shuffled node slots, walls keep the degree of their neighbors low
+static int graph_build( Graph *graph, const isla_grid *grid, int width ) {
+	static const int dx[BENCH_DEGREE] = {1, -1, 0, 0, 1, 1, -1, -1};
+	static const int dy[BENCH_DEGREE] = {0, 0, 1, -1, 1, -1, 1, -1};
+	size_t count = (size_t) width * width;
+	size_t i;
+	int x, y, k;
+	graph->width = width;
+	graph->nodes = calloc( count, sizeof( *graph->nodes ));
+	graph->neighbors = malloc( count * BENCH_DEGREE * sizeof( *graph->neighbors ));
+	graph->costs = malloc( count * BENCH_DEGREE * sizeof( *graph->costs ));
+	graph->degree = calloc( count, 1 );
+	graph->cell = malloc( count * sizeof( *graph->cell ));
+	if ( graph->nodes == NULL || graph->neighbors == NULL || graph->costs == NULL || graph->degree == NULL || graph->cell == NULL ) {
+		return 0;
+	}
+	for ( i = 0; i < count; i++ ) {
+		graph->cell[i] = (unsigned) i;
+	}
+	for ( i = count - 1; i > 0; i-- ) {
+		size_t j = rng_next() % (i + 1);
+		unsigned tmp = graph->cell[i];
+		graph->cell[i] = graph->cell[j];
+		graph->cell[j] = tmp;
+	}
+	for ( y = 0; y < width; y++ ) {
+		for ( x = 0; x < width; x++ ) {
+			size_t node = graph->cell[(size_t) y * width + x];
+			graph->nodes[node].x = x;
+			graph->nodes[node].y = y;
+			if ( isla_grid_is_blocked( grid, x, y, 0 )) {
+				continue;
+			}
+			for ( k = 0; k < BENCH_DEGREE; k++ ) {
+				int nx = x + dx[k], ny = y + dy[k];
+				if ( nx < 0 || ny < 0 || nx >= width || ny >= width || isla_grid_is_blocked( grid, nx, ny, 0 )) {
+					continue;
+				}
+				if ( k >= 4 && (isla_grid_is_blocked( grid, nx, y, 0 ) || isla_grid_is_blocked( grid, x, ny, 0 ))) {
+					continue;
+				}
+				graph->neighbors[node * BENCH_DEGREE + graph->degree[node]] = graph->cell[(size_t) ny * width + nx];
+				graph->costs[node * BENCH_DEGREE + graph->degree[node]] = k >= 4 ? ISLA_GRID_COST_DIAGONAL : ISLA_GRID_COST_STRAIGHT;
+				graph->degree[node]++;
+			}
+		}
+	}
+	return 1;
+}
+
+static void graph_destroy( Graph *graph ) {
+	free( graph->nodes );
+	free( graph->neighbors );
+	free( graph->costs );
+	free( graph->degree );
+	free( graph->cell );
+}
+
+int main( int argc, char **argv ) {
+	const char *mode = "graph";
+	int width = 2048;
+	int density = 25;
+	long queries = 50;
+	isla_grid grid;
+	Graph graph;
+	isla_properties properties = {0};
+	isla_workspace workspace;
+	void *userdata;
+	size_t expansions = 0;
+	long solved = 0;
+	double started, elapsed;
+	long i;
+
+	for ( i = 1; i < argc; i++ ) {
+		if ( strcmp( argv[i], "-m" ) == 0 && i + 1 < argc ) {
+			mode = argv[++i];
+		} else if ( strcmp( argv[i], "-w" ) == 0 && i + 1 < argc ) {
+			width = atoi( argv[++i] );
+		} else if ( strcmp( argv[i], "-d" ) == 0 && i + 1 < argc ) {
+			density = atoi( argv[++i] );
+		} else if ( strcmp( argv[i], "-q" ) == 0 && i + 1 < argc ) {
+			queries = atol( argv[++i] );
+		} else if ( strcmp( argv[i], "-s" ) == 0 && i + 1 < argc ) {
+			rng_state = strtoull( argv[++i], NULL, 10 ) * 0x9e3779b97f4a7c15ull | 1;
+		} else {
+			break;
+		}
+	}
+	if ( i != argc || width < 16 || (strcmp( mode, "grid" ) != 0 && strcmp( mode, "graph" ) != 0) ) {
+		fprintf( stderr, "Usage: %s [-m grid|graph] [-w width] [-d density] [-q queries] [-s seed]\n", argv[0] );
+		return 1;
+	}
+
+	if ( isla_grid_init( &grid, ISLA_GRID_SQUARE8, width, width, 1 ) != ISLA_OK ) {
+		fprintf( stderr, "Cannot allocate %dx%d grid\n", width, width );
+		return 1;
+	}
+	for ( i = 0; i < (long) width * width; i++ ) {
+		isla_grid_set_blocked( &grid, (int) (i % width), (int) (i / width), 0, (int) (rng_next() % 100) < density );
+	}
+	if ( strcmp( mode, "graph" ) == 0 ) {
+		if ( !graph_build( &graph, &grid, width )) {
+			fprintf( stderr, "Cannot allocate graph of %d nodes\n", width * width );
+			return 1;
+		}
+		properties.next_neighbor = graph_neighbor;
+		properties.eval_cost = graph_cost;
+		properties.estimate_cost = graph_estimate;
+		userdata = &graph;
+	} else {
+		isla_grid_properties( &grid, &properties );
+		userdata = &grid;
+	}
+	if ( isla_workspace_init( &workspace, 0, 0 ) != ISLA_OK ) {
+		return 1;
+	}
+	properties.workspace = &workspace;
+
+	started = now();
+	for ( i = 0; i < queries; i++ ) {
+		// Opposite corners region, so every query sweeps a large part of the map
+		int x0 = (int) (rng_next() % (unsigned) (width / 8)), y0 = (int) (rng_next() % (unsigned) (width / 8 + 1));
+		int x1 = width - 1 - x0, y1 = width - 1 - y0;
+		isla_node *start, *finish;
+		isla_search search;
+		isla_result result;
+		if ( isla_grid_is_blocked( &grid, x0, y0, 0 ) || isla_grid_is_blocked( &grid, x1, y1, 0 )) {
+			continue;
+		}
+		if ( userdata == &graph ) {
+			start = &graph.nodes[graph.cell[(size_t) y0 * width + x0]].node;
+			finish = &graph.nodes[graph.cell[(size_t) y1 * width + x1]].node;
+		} else {
+			start = isla_grid_node( &grid, x0, y0, 0 );
+			finish = isla_grid_node( &grid, x1, y1, 0 );
+		}
+		if ( isla_search_begin( &search, start, finish, &properties, userdata ) != ISLA_OK ) {
+			continue;
+		}
+		result = isla_search_step( &search, 0 );
+		expansions += search.expansions;
+		solved += result.status == ISLA_OK;
+		isla_destroy_path( result.path );
+	}
+	elapsed = now() - started;
+
+#ifdef ISLA_PREFETCH
+	printf( "prefetch on (batch %d), ", ISLA_PREFETCH_BATCH );
+#else
+	printf( "prefetch off, " );
+#endif
+	printf( "%s %dx%d: %ld queries (%ld found) in %.3f s, %.0f expansions/s\n", mode, width, width, queries, solved, elapsed, expansions / (elapsed > 0 ? elapsed : 1) );
+
+	isla_workspace_destroy( &workspace );
+	if ( userdata == &graph ) {
+		graph_destroy( &graph );
+	}
+	isla_grid_destroy( &grid );
+	return 0;
+}
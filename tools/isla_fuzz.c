@@ -0,0 +1,571 @@
+/*
+ isla_fuzz - differential correctness checker for isl_astar.h search engines
+
+ Generates random grids of every topology and random sparse graphs, builds all
+ preprocessing structures over them and solves random queries with every engine which
+ supports the case. Every path is checked to be a valid chain of moves from start to
+ finish, and its cost must be equal to the cost of the reference isla_find_path path.
+ On the first mismatch the case is printed and the program aborts.
+
+ Build: cc -O2 -o isla_fuzz tools/isla_fuzz.c -lm
+
+ Usage: isla_fuzz [-n iterations] [-s seed] [-v]
+
+ libFuzzer build, the input bytes define the grid or the graph directly:
+
+   clang -g -O1 -fsanitize=fuzzer,address,undefined -DISLA_FUZZ_LIBFUZZER -o isla_fuzzer tools/isla_fuzz.c -lm
+   ./isla_fuzzer -max_len=512 corpus/
+*/
+
+#define ISL_ASTAR_IMPLEMENTATION
+#include "../isl_astar.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define FUZZ_EPSILON 1e-6
+#define FUZZ_MAX_DEGREE 8
+#define FUZZ_QUERIES 8
+
+typedef struct {
+	unsigned long long state;
+} Rng;
+
+typedef struct {
+	size_t count;
+	isla_node *nodes;
+	isla_cost *matrix;
+	size_t *first;
+	size_t *targets;
+	int undirected;
+	int unit;
+} Graph;
+
+typedef struct {
+	const char *kind;
+	unsigned long long seed;
+	int topology;
+	int width;
+	int height;
+	int depth;
+	size_t count;
+	size_t start;
+	size_t finish;
+} Case;
+
+static Case current;
+static size_t checks = 0;
+
+static unsigned rng_next( Rng *rng ) {
+	rng->state ^= rng->state << 13;
+	rng->state ^= rng->state >> 7;
+	rng->state ^= rng->state << 17;
+	return (unsigned) (rng->state >> 16);
+}
+
+static unsigned rng_below( Rng *rng, unsigned n ) {
+	return n > 0 ? rng_next( rng ) % n : 0;
+}
+
+static void fail( const char *engine, const char *what, double expected, double got ) {
+	fprintf( stderr, "MISMATCH %s: %s, expected %.9g got %.9g\n", engine, what, expected, got );
+	fprintf( stderr, "  case %s seed %llu topology %d size %dx%dx%d nodes %lu start %lu finish %lu\n", current.kind, current.seed,
+		current.topology, current.width, current.height, current.depth, (unsigned long) current.count, (unsigned long) current.start, (unsigned long) current.finish );
+	abort();
+}
+
+static int same_cost( double a, double b ) {
+	return fabs( a - b ) <= FUZZ_EPSILON * (1 + fabs( a ));
+}
+
+// Path is reversed, every node must be a neighbor of the next one
+static double path_cost( const char *engine, isla_path *path, isla_node *start, isla_node *finish, isla_properties *properties, void *userdata ) {
+	double cost = 0;
+	size_t i;
+	if ( path == NULL || path->length == 0 ) {
+		fail( engine, "no path", 1, 0 );
+	}
+	if ( path->nodes[0] != finish || path->nodes[path->length-1] != start ) {
+		fail( engine, "path endpoints", 0, 1 );
+	}
+	for ( i = 1; i < path->length; i++ ) {
+		isla_node *neighbor = NULL;
+		while ( (neighbor = properties->next_neighbor( path->nodes[i], neighbor, userdata )) != NULL && neighbor != path->nodes[i-1] ) {
+		}
+		if ( neighbor == NULL ) {
+			fail( engine, "path step is not a move", (double) i, 0 );
+		}
+		cost += properties->eval_cost( path->nodes[i], path->nodes[i-1], userdata );
+	}
+	return cost;
+}
+
+// Checks result against the reference and releases it
+static void check( const char *engine, isla_result result, isla_status expected_status, double expected_cost, isla_node *start, isla_node *finish, isla_properties *properties, void *userdata ) {
+	checks++;
+	if ( (result.status == ISLA_OK) != (expected_status == ISLA_OK) ) {
+		fail( engine, isla_strstatus( result.status ), expected_status, result.status );
+	}
+	if ( result.status == ISLA_OK ) {
+		double cost = path_cost( engine, result.path, start, finish, properties, userdata );
+		if ( !same_cost( expected_cost, cost )) {
+			fail( engine, "path cost", expected_cost, cost );
+		}
+	}
+	isla_destroy_path( result.path );
+}
+
+static void check_cost( const char *engine, int found, double cost, isla_status expected_status, double expected_cost ) {
+	checks++;
+	if ( found != (expected_status == ISLA_OK) ) {
+		fail( engine, "reachability", expected_status == ISLA_OK, found );
+	}
+	if ( found && !same_cost( expected_cost, cost )) {
+		fail( engine, "distance", expected_cost, cost );
+	}
+}
+
+// Engines which work through plain callbacks
+static void check_generic( isla_node *start, isla_node *finish, isla_properties *properties, void *userdata, size_t count, isla_status status, double cost, Rng *rng ) {
+	isla_properties local = *properties;
+	isla_workspace workspace;
+	isla_search search;
+	isla_result result;
+	isla_range range = {0};
+	isla_alternatives alternatives = {3, 0.5, 0.6, 0, 0};
+	isla_result routes[3];
+	size_t found;
+	size_t i;
+
+	if ( isla_workspace_init( &workspace, 0, 2 ) == ISLA_OK ) {
+		local.workspace = &workspace;
+		check( "astar+workspace", isla_find_path( start, finish, &local, userdata ), status, cost, start, finish, properties, userdata );
+		local.reopen_closed = 1;
+		check( "astar+reopen", isla_find_path( start, finish, &local, userdata ), status, cost, start, finish, properties, userdata );
+		local = *properties;
+		isla_workspace_destroy( &workspace );
+	}
+
+	if ( isla_search_begin( &search, start, finish, properties, userdata ) == ISLA_OK ) {
+		do {
+			result = isla_search_step( &search, 1 + rng_below( rng, 4 ));
+		} while ( result.status == ISLA_IN_PROGRESS );
+		check( "search_step", result, status, cost, start, finish, properties, userdata );
+	}
+
+	if ( count <= 64 ) {
+		check( "ida", isla_find_path_ida( start, finish, properties, count + 1, 256, userdata ), status, cost, start, finish, properties, userdata );
+	}
+	check( "sma", isla_find_path_sma( start, finish, properties, count + 2, userdata ), status, cost, start, finish, properties, userdata );
+
+	if ( isla_find_range( start, -1, properties, &range, userdata ) == ISLA_OK ) {
+		int reached = 0;
+		double distance = 0;
+		for ( i = 0; i < range.count; i++ ) {
+			if ( i > 0 && range.reached[i].cost < range.reached[i-1].cost ) {
+				fail( "range", "order", range.reached[i-1].cost, range.reached[i].cost );
+			}
+			if ( range.reached[i].node == finish ) {
+				reached = 1;
+				distance = range.reached[i].cost;
+			}
+		}
+		check_cost( "range", reached, distance, status, cost );
+		isla_range_destroy( &range );
+	}
+
+	found = isla_find_path_alternatives( start, finish, properties, &alternatives, routes, userdata );
+	// The first route is found before any penalty is applied, so it is optimal
+	check( "alternatives", routes[0], status, cost, start, finish, properties, userdata );
+	for ( i = 1; i < found; i++ ) {
+		double alternative = path_cost( "alternatives", routes[i].path, start, finish, properties, userdata );
+		if ( alternative < cost - FUZZ_EPSILON ) {
+			fail( "alternatives", "route shorter than optimal", cost, alternative );
+		}
+		isla_destroy_path( routes[i].path );
+	}
+}
+
+static isla_status reference( isla_node *start, isla_node *finish, isla_properties *properties, void *userdata, double *cost ) {
+	isla_result result = isla_find_path( start, finish, properties, userdata );
+	*cost = 0;
+	if ( result.status == ISLA_OK ) {
+		*cost = path_cost( "reference", result.path, start, finish, properties, userdata );
+	} else if ( result.status != ISLA_BLOCKED ) {
+		fail( "reference", isla_strstatus( result.status ), ISLA_OK, result.status );
+	}
+	isla_destroy_path( result.path );
+	return result.status;
+}
+
+// Grids
+
+static void grid_case( Rng *rng, int topology, int width, int height, int depth, const unsigned char *bits, size_t nbits ) {
+	isla_grid grid;
+	isla_properties properties = {0};
+	isla_subgoal_graph sg;
+	isla_gb gb;
+	isla_dh dh;
+	isla_deadend de;
+	int has_sg = 0, has_gb = 0, has_dh = 0, has_de = 0;
+	int density = 10 + (int) rng_below( rng, 30 );
+	size_t free_cells = 0;
+	size_t total;
+	isla_node *seed = NULL;
+	int x, y, z, q;
+
+	if ( isla_grid_init( &grid, (isla_grid_topology) topology, width, height, depth ) != ISLA_OK ) {
+		return;
+	}
+	for ( z = 0; z < depth; z++ ) {
+		for ( y = 0; y < height; y++ ) {
+			for ( x = 0; x < width; x++ ) {
+				size_t bit = ((size_t) z * height + y) * width + x;
+				int blocked = bits != NULL ? (bits[(bit / 8) % nbits] >> (bit % 8)) & 1 : (int) rng_below( rng, 100 ) < density;
+				isla_grid_set_blocked( &grid, x, y, z, blocked );
+				if ( !blocked ) {
+					free_cells++;
+					seed = seed == NULL ? isla_grid_node( &grid, x, y, z ) : seed;
+				}
+			}
+		}
+	}
+	if ( seed == NULL ) {
+		isla_grid_destroy( &grid );
+		return;
+	}
+	isla_grid_properties( &grid, &properties );
+	total = (size_t) grid.stride_z * (topology >= ISLA_GRID_VOXEL6 ? (size_t) depth + 2 : 1);
+
+	current.kind = "grid";
+	current.topology = topology;
+	current.width = width;
+	current.height = height;
+	current.depth = depth;
+	current.count = free_cells;
+
+	has_sg = topology == ISLA_GRID_SQUARE8 && isla_subgoal_init( &sg, &grid ) == ISLA_OK;
+	has_gb = topology < ISLA_GRID_VOXEL6 && width * height <= 576 && isla_gb_build( &gb, &grid ) == ISLA_OK;
+	has_dh = isla_dh_init( &dh, grid.nodes, total, seed, 1 + rng_below( rng, ISLA_DH_MAX_LANDMARKS ), rng_below( rng, 2 ) ? 8 : 16, &properties, &grid ) == ISLA_OK;
+	has_de = isla_deadend_init( &de, grid.nodes, total, seed, &properties, &grid ) == ISLA_OK;
+
+	for ( q = 0; q < FUZZ_QUERIES; q++ ) {
+		int x0 = (int) rng_below( rng, (unsigned) width ), y0 = (int) rng_below( rng, (unsigned) height ), z0 = (int) rng_below( rng, (unsigned) depth );
+		int x1 = (int) rng_below( rng, (unsigned) width ), y1 = (int) rng_below( rng, (unsigned) height ), z1 = (int) rng_below( rng, (unsigned) depth );
+		isla_node *start = isla_grid_node( &grid, x0, y0, z0 );
+		isla_node *finish = isla_grid_node( &grid, x1, y1, z1 );
+		isla_properties wrapped = {0};
+		isla_status status;
+		double cost;
+		if ( isla_grid_is_blocked( &grid, x0, y0, z0 ) || isla_grid_is_blocked( &grid, x1, y1, z1 )) {
+			continue;
+		}
+		current.start = (size_t) (start - grid.nodes);
+		current.finish = (size_t) (finish - grid.nodes);
+		status = reference( start, finish, &properties, &grid, &cost );
+		check_generic( start, finish, &properties, &grid, free_cells, status, cost, rng );
+
+		if ( status == ISLA_OK ) {
+			isla_result result = isla_find_path( start, finish, &properties, &grid );
+			unsigned char code[1024];
+			size_t size = sizeof( code );
+			if ( isla_grid_encode_path( &grid, result.path, code, &size ) == ISLA_OK ) {
+				check( "grid_code", isla_grid_decode_path( &grid, code, size ), status, cost, start, finish, &properties, &grid );
+			}
+			isla_destroy_path( result.path );
+		}
+		if ( has_sg ) {
+			check( "subgoal", isla_subgoal_find_path( &sg, x0, y0, x1, y1, NULL ), status, cost, start, finish, &properties, &grid );
+		}
+		if ( has_gb ) {
+			isla_gb_properties( &gb, &wrapped );
+			check( "gb", isla_find_path( start, finish, &wrapped, &gb ), status, cost, start, finish, &properties, &grid );
+		}
+		if ( has_dh ) {
+			memset( &wrapped, 0, sizeof( wrapped ));
+			isla_dh_properties( &dh, &wrapped );
+			check( "dh", isla_find_path( start, finish, &wrapped, &dh ), status, cost, start, finish, &properties, &grid );
+		}
+		if ( has_de ) {
+			memset( &wrapped, 0, sizeof( wrapped ));
+			isla_deadend_properties( &de, &wrapped );
+			check( "deadend", isla_find_path( start, finish, &wrapped, &de ), status, cost, start, finish, &properties, &grid );
+		}
+	}
+
+	if ( has_sg ) {
+		isla_subgoal_destroy( &sg );
+	}
+	if ( has_gb ) {
+		isla_gb_destroy( &gb );
+	}
+	if ( has_dh ) {
+		isla_dh_destroy( &dh );
+	}
+	if ( has_de ) {
+		isla_deadend_destroy( &de );
+	}
+	isla_grid_destroy( &grid );
+}
+
+// Sparse graphs in CSR form, edges are unique and without loops
+
+static isla_node *graph_neighbor( isla_node *node, isla_node *prev, void *userdata ) {
+	Graph *graph = userdata;
+	size_t index = (size_t) (node - graph->nodes);
+	size_t i = graph->first[index];
+	if ( prev != NULL ) {
+		while ( graph->nodes + graph->targets[i] != prev ) {
+			i++;
+		}
+		i++;
+	}
+	return i < graph->first[index + 1] ? graph->nodes + graph->targets[i] : NULL;
+}
+
+static isla_cost graph_cost( isla_node *node1, isla_node *node2, void *userdata ) {
+	Graph *graph = userdata;
+	return graph->matrix[(size_t) (node1 - graph->nodes) * graph->count + (size_t) (node2 - graph->nodes)];
+}
+
+static isla_cost graph_zero( isla_node *node1, isla_node *node2, void *userdata ) {
+	(void) node1;
+	(void) node2;
+	(void) userdata;
+	return 0;
+}
+
+static size_t graph_successors( const void *key, void *successors, void *userdata ) {
+	Graph *graph = userdata;
+	unsigned index;
+	size_t i;
+	memcpy( &index, key, sizeof( index ));
+	for ( i = graph->first[index]; i < graph->first[index + 1]; i++ ) {
+		unsigned target = (unsigned) graph->targets[i];
+		memcpy( (unsigned char *) successors + (i - graph->first[index]) * sizeof( target ), &target, sizeof( target ));
+	}
+	return graph->first[index + 1] - graph->first[index];
+}
+
+static int graph_build( Graph *graph, size_t count, int undirected, int unit, const unsigned char *bytes, size_t nbytes, Rng *rng ) {
+	size_t *degree = calloc( count, sizeof( *degree ));
+	size_t edges = count * (1 + rng_below( rng, 3 ));
+	size_t i, a, b, k;
+	graph->count = count;
+	graph->undirected = undirected;
+	graph->unit = unit;
+	graph->nodes = calloc( count, sizeof( *graph->nodes ));
+	graph->matrix = calloc( count * count, sizeof( *graph->matrix ));
+	graph->first = calloc( count + 1, sizeof( *graph->first ));
+	graph->targets = malloc( count * FUZZ_MAX_DEGREE * sizeof( *graph->targets ));
+	if ( degree == NULL || graph->nodes == NULL || graph->matrix == NULL || graph->first == NULL || graph->targets == NULL ) {
+		free( degree );
+		return 0;
+	}
+	for ( k = 0; k < edges; k++ ) {
+		isla_cost cost;
+		if ( bytes != NULL ) {
+			if ( 3 * k + 2 >= nbytes ) {
+				break;
+			}
+			a = bytes[3*k] % count;
+			b = bytes[3*k+1] % count;
+			cost = unit ? 1 : 1 + bytes[3*k+2] % 9;
+		} else {
+			a = rng_below( rng, (unsigned) count );
+			b = rng_below( rng, (unsigned) count );
+			cost = unit ? 1 : 1 + rng_below( rng, 9 ) + (rng_below( rng, 2 ) ? 0.5 : 0);
+		}
+		if ( a == b || graph->matrix[a * count + b] != 0 || degree[a] >= FUZZ_MAX_DEGREE || (undirected && degree[b] >= FUZZ_MAX_DEGREE) ) {
+			continue;
+		}
+		graph->matrix[a * count + b] = cost;
+		degree[a]++;
+		if ( undirected ) {
+			graph->matrix[b * count + a] = cost;
+			degree[b]++;
+		}
+	}
+	for ( a = 0; a < count; a++ ) {
+		graph->first[a + 1] = graph->first[a];
+		for ( b = 0; b < count; b++ ) {
+			if ( graph->matrix[a * count + b] != 0 ) {
+				graph->targets[graph->first[a + 1]++] = b;
+			}
+		}
+	}
+	for ( i = 0; i < count; i++ ) {
+		graph->nodes[i].data = NULL;
+	}
+	free( degree );
+	return 1;
+}
+
+static void graph_destroy( Graph *graph ) {
+	free( graph->nodes );
+	free( graph->matrix );
+	free( graph->first );
+	free( graph->targets );
+}
+
+static void graph_case( Rng *rng, size_t count, int undirected, int unit, const unsigned char *bytes, size_t nbytes, int external ) {
+	Graph graph;
+	isla_properties properties = {0};
+	isla_apsp apsp;
+	isla_dh dh;
+	isla_deadend de;
+	int has_apsp, has_dh = 0, has_de = 0;
+	int q;
+
+	if ( !graph_build( &graph, count, undirected, unit, bytes, nbytes, rng )) {
+		graph_destroy( &graph );
+		return;
+	}
+	properties.next_neighbor = graph_neighbor;
+	properties.eval_cost = graph_cost;
+	properties.estimate_cost = graph_zero;
+
+	current.kind = undirected ? "undirected graph" : "directed graph";
+	current.topology = unit;
+	current.width = current.height = current.depth = 0;
+	current.count = count;
+
+	has_apsp = isla_apsp_init( &apsp, graph.nodes, count, &properties, &graph ) == ISLA_OK;
+	if ( undirected ) {
+		has_dh = isla_dh_init( &dh, graph.nodes, count, graph.nodes, 1 + rng_below( rng, ISLA_DH_MAX_LANDMARKS ), rng_below( rng, 2 ) ? 8 : 16, &properties, &graph ) == ISLA_OK;
+		has_de = isla_deadend_init( &de, graph.nodes, count, graph.nodes, &properties, &graph ) == ISLA_OK;
+	}
+
+	for ( q = 0; q < FUZZ_QUERIES; q++ ) {
+		size_t a = rng_below( rng, (unsigned) count );
+		size_t b = rng_below( rng, (unsigned) count );
+		isla_node *start = graph.nodes + a;
+		isla_node *finish = graph.nodes + b;
+		isla_properties wrapped = {0};
+		isla_status status;
+		double cost;
+		current.start = a;
+		current.finish = b;
+		status = reference( start, finish, &properties, &graph, &cost );
+		check_generic( start, finish, &properties, &graph, count, status, cost, rng );
+
+		if ( has_apsp ) {
+			check_cost( "apsp_distance", isla_apsp_reachable( &apsp, start, finish ), isla_apsp_distance( &apsp, start, finish ), status, cost );
+			check( "apsp_path", isla_apsp_path( &apsp, start, finish ), status, cost, start, finish, &properties, &graph );
+		}
+		if ( has_dh ) {
+			isla_dh_properties( &dh, &wrapped );
+			check( "dh", isla_find_path( start, finish, &wrapped, &dh ), status, cost, start, finish, &properties, &graph );
+		}
+		if ( has_de ) {
+			memset( &wrapped, 0, sizeof( wrapped ));
+			isla_deadend_properties( &de, &wrapped );
+			check( "deadend", isla_find_path( start, finish, &wrapped, &de ), status, cost, start, finish, &properties, &graph );
+		}
+		if ( external && unit ) {
+			isla_implicit implicit;
+			isla_external options = {0};
+			unsigned ka = (unsigned) a, kb = (unsigned) b;
+			options.buffer_states = 16;
+			options.max_open_runs = 3;
+			options.locality = 0;
+			options.max_depth = count + 1;
+			if ( isla_implicit_init( &implicit, sizeof( unsigned ), count, graph_successors, &graph ) == ISLA_OK ) {
+				isla_result result = isla_find_path_external( &implicit, &ka, &kb, &options );
+				checks++;
+				if ( (result.status == ISLA_OK) != (status == ISLA_OK) ) {
+					fail( "external", isla_strstatus( result.status ), status, result.status );
+				}
+				if ( result.status == ISLA_OK && !same_cost( cost, (double) result.path->length - 1 )) {
+					fail( "external", "path length", cost, (double) result.path->length - 1 );
+				}
+				isla_destroy_path( result.path );
+				isla_implicit_destroy( &implicit );
+			}
+		}
+	}
+
+	if ( has_apsp ) {
+		isla_apsp_destroy( &apsp );
+	}
+	if ( has_dh ) {
+		isla_dh_destroy( &dh );
+	}
+	if ( has_de ) {
+		isla_deadend_destroy( &de );
+	}
+	graph_destroy( &graph );
+}
+
+static const int topologies[] = {ISLA_GRID_SQUARE4, ISLA_GRID_SQUARE8, ISLA_GRID_HEX, ISLA_GRID_VOXEL6, ISLA_GRID_VOXEL18, ISLA_GRID_VOXEL26};
+
+#ifdef ISLA_FUZZ_LIBFUZZER
+// First byte selects the case, next ones set its size, the rest is the map or the edge list
+int LLVMFuzzerTestOneInput( const unsigned char *data, size_t size ) {
+	Rng rng;
+	size_t i;
+	if ( size < 5 ) {
+		return 0;
+	}
+	rng.state = 14695981039346656037ull;
+	for ( i = 0; i < size; i++ ) {
+		rng.state = (rng.state ^ data[i]) * 1099511628211ull;
+	}
+	rng.state |= 1;
+	current.seed = rng.state;
+	if ( data[0] & 0x80 ) {
+		graph_case( &rng, 2 + data[1] % 100, data[0] & 1, (data[0] >> 1) & 1, data + 3, size - 3, 0 );
+	} else {
+		int topology = topologies[(data[0] & 0x7f) % (sizeof( topologies ) / sizeof( *topologies ))];
+		int is_3d = topology >= ISLA_GRID_VOXEL6;
+		grid_case( &rng, topology, 1 + data[1] % (is_3d ? 8 : 24), 1 + data[2] % (is_3d ? 8 : 24), is_3d ? 1 + data[3] % 6 : 1, data + 4, size - 4 );
+	}
+	return 0;
+}
+#else
+static void random_case( Rng *rng, int external ) {
+	if ( rng_below( rng, 2 )) {
+		int topology = topologies[rng_below( rng, sizeof( topologies ) / sizeof( *topologies ))];
+		int is_3d = topology >= ISLA_GRID_VOXEL6;
+		int width = 2 + (int) rng_below( rng, is_3d ? 8 : 30 );
+		int height = 2 + (int) rng_below( rng, is_3d ? 8 : 30 );
+		int depth = is_3d ? 2 + (int) rng_below( rng, 6 ) : 1;
+		grid_case( rng, topology, width, height, depth, NULL, 0 );
+	} else {
+		graph_case( rng, 2 + rng_below( rng, 150 ), (int) rng_below( rng, 2 ), (int) rng_below( rng, 3 ) == 0, NULL, 0, external );
+	}
+}
+
+int main( int argc, char **argv ) {
+	unsigned long long seed = 1;
+	int verbose = 0;
+	long iterations = 1000;
+	long i;
+	for ( i = 1; i < argc; i++ ) {
+		if ( strcmp( argv[i], "-n" ) == 0 && i + 1 < argc ) {
+			iterations = atol( argv[++i] );
+		} else if ( strcmp( argv[i], "-s" ) == 0 && i + 1 < argc ) {
+			seed = strtoull( argv[++i], NULL, 10 );
+		} else if ( strcmp( argv[i], "-v" ) == 0 ) {
+			verbose = 1;
+		} else {
+			fprintf( stderr, "Usage: %s [-n iterations] [-s seed] [-v]\n", argv[0] );
+			return 1;
+		}
+	}
+	for ( i = 0; i < iterations; i++ ) {
+		Rng rng;
+		// Every case has its own seed, so a failure is reproduced by -s seed -n 1
+		current.seed = seed + (unsigned long long) i;
+		rng.state = current.seed * 0x9e3779b97f4a7c15ull | 1;
+		random_case( &rng, 1 );
+		if ( verbose ) {
+			fprintf( stderr, "case %llu %s nodes %lu ok\n", current.seed, current.kind, (unsigned long) current.count );
+		}
+	}
+	printf( "%ld cases, %lu checks passed\n", iterations, (unsigned long) checks );
+	return 0;
+}
+#endif
@@ -0,0 +1,436 @@
+/*
+ isla_replay - reruns queries captured by isla_recorder and compares search engines
+
+ Every query is rebuilt from the recorded neighborhoods, costs and estimates, so it runs
+ exactly like in production, but under a profiler and without the game or server. Each
+ selected engine solves the query, its path cost is checked against the recorded one and
+ the time is measured.
+
+ Build: cc -O2 -o isla_replay tools/isla_replay.c -lm
+
+ Usage: isla_replay [-e engines] [-r repeats] [-v] queries.rec
+
+ Engines are comma separated: astar (isla_find_path, also must reproduce the recorded path
+ exactly), dijkstra (zero heuristic), ida, sma; default is all but ida, which reexpands
+ too much on large graphs. With -v every query is printed. Nodes which the recorded search
+ didn't expand have no known neighbors, such requests of other engines are counted as
+ misses, they may make results differ.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#define ISL_ASTAR_IMPLEMENTATION
+#include "../isl_astar.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <time.h>
+
+#define REPLAY_ENGINES 4
+#define REPLAY_EPSILON 1e-9
+
+typedef struct {
+	unsigned capacity;
+	isla_node *nodes;
+	long *first;
+	unsigned *degree;
+	double *estimates;
+	unsigned char *finishes;
+	unsigned *edge_nodes;
+	double *edge_costs;
+	size_t edges;
+	size_t edges_allocated;
+	unsigned finish;
+	size_t misses;
+} Replay;
+
+typedef struct {
+	const char *name;
+	int enabled;
+	size_t queries;
+	size_t status_mismatches;
+	size_t cost_mismatches;
+	size_t path_mismatches;
+	size_t misses;
+	double seconds;
+} Engine;
+
+static Engine engines[REPLAY_ENGINES] = {
+	{"astar", 1, 0, 0, 0, 0, 0, 0},
+	{"dijkstra", 1, 0, 0, 0, 0, 0, 0},
+	{"ida", 0, 0, 0, 0, 0, 0, 0},
+	{"sma", 1, 0, 0, 0, 0, 0, 0},
+};
+
+static unsigned read_u32( const unsigned char *buffer ) {
+	return (unsigned) buffer[0] | (unsigned) buffer[1] << 8 | (unsigned) buffer[2] << 16 | (unsigned) buffer[3] << 24;
+}
+
+static double read_cost( const unsigned char *buffer ) {
+	union {
+		double d;
+		unsigned long long u;
+	} bits;
+	int i;
+	bits.u = 0;
+	for ( i = 0; i < 8; i++ ) {
+		bits.u |= (unsigned long long) buffer[i] << (8 * i);
+	}
+	return bits.d;
+}
+
+static double now( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (double) ts.tv_sec + 1e-9 * (double) ts.tv_nsec;
+}
+
+static int replay_reserve( Replay *replay, unsigned id ) {
+	unsigned capacity = replay->capacity > 0 ? replay->capacity : 1024;
+	unsigned i;
+	if ( id < replay->capacity ) {
+		return 1;
+	}
+	while ( capacity <= id ) {
+		if ( capacity > UINT_MAX / 2 ) {
+			return 0;
+		}
+		capacity *= 2;
+	}
+	replay->nodes = realloc( replay->nodes, capacity * sizeof( *replay->nodes ));
+	replay->first = realloc( replay->first, capacity * sizeof( *replay->first ));
+	replay->degree = realloc( replay->degree, capacity * sizeof( *replay->degree ));
+	replay->estimates = realloc( replay->estimates, capacity * sizeof( *replay->estimates ));
+	replay->finishes = realloc( replay->finishes, capacity );
+	if ( replay->nodes == NULL || replay->first == NULL || replay->degree == NULL || replay->estimates == NULL || replay->finishes == NULL ) {
+		return 0;
+	}
+	for ( i = replay->capacity; i < capacity; i++ ) {
+		memset( replay->nodes + i, 0, sizeof( *replay->nodes ));
+		replay->first[i] = -1;
+		replay->estimates[i] = NAN;
+		replay->finishes[i] = 0;
+	}
+	replay->capacity = capacity;
+	return 1;
+}
+
+static void replay_reset( Replay *replay ) {
+	unsigned i;
+	for ( i = 0; i < replay->capacity; i++ ) {
+		replay->first[i] = -1;
+		replay->estimates[i] = NAN;
+		replay->finishes[i] = 0;
+	}
+	replay->edges = 0;
+	replay->misses = 0;
+}
+
+static isla_node *replay_neighbor( isla_node *node, isla_node *prev, void *userdata ) {
+	Replay *replay = userdata;
+	unsigned id = (unsigned) (node - replay->nodes);
+	unsigned i = 0;
+	if ( replay->first[id] < 0 ) {
+		replay->misses += prev == NULL;
+		return NULL;
+	}
+	if ( prev != NULL ) {
+		unsigned prev_id = (unsigned) (prev - replay->nodes);
+		while ( i < replay->degree[id] && replay->edge_nodes[replay->first[id] + i] != prev_id ) {
+			i++;
+		}
+		i++;
+	}
+	return i < replay->degree[id] ? replay->nodes + replay->edge_nodes[replay->first[id] + i] : NULL;
+}
+
+static isla_cost replay_cost( isla_node *node1, isla_node *node2, void *userdata ) {
+	Replay *replay = userdata;
+	unsigned id = (unsigned) (node1 - replay->nodes);
+	unsigned to = (unsigned) (node2 - replay->nodes);
+	unsigned i;
+	for ( i = 0; replay->first[id] >= 0 && i < replay->degree[id]; i++ ) {
+		if ( replay->edge_nodes[replay->first[id] + i] == to ) {
+			return replay->edge_costs[replay->first[id] + i];
+		}
+	}
+	replay->misses++;
+	return HUGE_VAL;
+}
+
+static isla_cost replay_estimate( isla_node *node1, isla_node *node2, void *userdata ) {
+	Replay *replay = userdata;
+	double estimate = replay->estimates[node1 - replay->nodes];
+	if ( (unsigned) (node2 - replay->nodes) != replay->finish || isnan( estimate )) {
+		replay->misses++;
+		return 0;
+	}
+	return estimate;
+}
+
+static isla_cost replay_zero( isla_node *node1, isla_node *node2, void *userdata ) {
+	(void) node1;
+	(void) node2;
+	(void) userdata;
+	return 0;
+}
+
+static int replay_is_finish( isla_node *node, void *userdata ) {
+	Replay *replay = userdata;
+	return replay->finishes[node - replay->nodes];
+}
+
+// Paths are reversed, every node is reached from the next one
+static double path_cost( Replay *replay, const isla_node *const *nodes, size_t length ) {
+	double cost = 0;
+	size_t i;
+	for ( i = 1; i < length; i++ ) {
+		cost += replay_cost( (isla_node *) nodes[i], (isla_node *) nodes[i-1], replay );
+	}
+	return cost;
+}
+
+static void replay_query( Replay *replay, unsigned start, int recorded_status, isla_node **recorded, size_t recorded_length, int repeats, int verbose, size_t query ) {
+	double recorded_cost = path_cost( replay, (const isla_node *const *) recorded, recorded_length );
+	isla_properties properties = {0};
+	int any_finish = 0;
+	unsigned i;
+	int e;
+
+	for ( i = 0; i < replay->capacity && !any_finish; i++ ) {
+		any_finish = replay->finishes[i];
+	}
+	properties.next_neighbor = replay_neighbor;
+	properties.eval_cost = replay_cost;
+	properties.is_finish_node = any_finish ? replay_is_finish : NULL;
+	if ( verbose ) {
+		printf( "%lu %s %.6g", (unsigned long) query, isla_strstatus( (isla_status) recorded_status ), recorded_cost );
+	}
+	for ( e = 0; e < REPLAY_ENGINES; e++ ) {
+		Engine *engine = engines + e;
+		isla_result result = {ISLA_OK, NULL};
+		double begin;
+		double cost;
+		int r;
+		if ( !engine->enabled ) {
+			continue;
+		}
+		properties.estimate_cost = e == 1 ? replay_zero : replay_estimate;
+		replay->misses = 0;
+		begin = now();
+		for ( r = 0; r < repeats; r++ ) {
+			isla_node *start_node = replay->nodes + start;
+			isla_node *finish_node = replay->nodes + replay->finish;
+			isla_destroy_path( result.path );
+			switch ( e ) {
+				case 0: case 1: result = isla_find_path( start_node, finish_node, &properties, replay ); break;
+				case 2: result = isla_find_path_ida( start_node, finish_node, &properties, replay->capacity, 1 << 16, replay ); break;
+				default: result = isla_find_path_sma( start_node, finish_node, &properties, replay->capacity + 2, replay ); break;
+			}
+		}
+		engine->seconds += now() - begin;
+		engine->misses += replay->misses / (size_t) repeats;
+		engine->queries++;
+		cost = result.status == ISLA_OK ? path_cost( replay, (const isla_node *const *) result.path->nodes, result.path->length ) : 0;
+		if ( (int) result.status != recorded_status ) {
+			engine->status_mismatches++;
+		} else if ( result.status == ISLA_OK && fabs( cost - recorded_cost ) > REPLAY_EPSILON * (1 + recorded_cost) ) {
+			engine->cost_mismatches++;
+		}
+		if ( e == 0 && result.status == ISLA_OK && (result.path->length != recorded_length || memcmp( result.path->nodes, recorded, recorded_length * sizeof( *recorded )) != 0) ) {
+			engine->path_mismatches++;
+		}
+		if ( verbose ) {
+			printf( " %s:%s:%.6g", engine->name, isla_strstatus( result.status ), cost );
+		}
+		isla_destroy_path( result.path );
+	}
+	if ( verbose ) {
+		printf( "\n" );
+	}
+}
+
+static unsigned char *read_file( const char *filename, size_t *size ) {
+	FILE *f = fopen( filename, "rb" );
+	unsigned char *data = NULL;
+	size_t allocated = 0;
+	size_t n;
+	*size = 0;
+	if ( f == NULL ) {
+		return NULL;
+	}
+	do {
+		if ( *size == allocated ) {
+			unsigned char *grown = realloc( data, allocated = allocated ? allocated * 2 : 1 << 16 );
+			if ( grown == NULL ) {
+				free( data );
+				fclose( f );
+				return NULL;
+			}
+			data = grown;
+		}
+		n = fread( data + *size, 1, allocated - *size, f );
+		*size += n;
+	} while ( n > 0 );
+	fclose( f );
+	return data;
+}
+
+int main( int argc, char **argv ) {
+	Replay replay = {0};
+	unsigned char *data;
+	size_t size;
+	size_t pos = 8;
+	size_t queries = 0;
+	unsigned start = 0;
+	int repeats = 1;
+	int verbose = 0;
+	int i, e;
+	isla_node **recorded = NULL;
+	size_t recorded_allocated = 0;
+
+	for ( i = 1; i < argc - 1; i++ ) {
+		if ( strcmp( argv[i], "-r" ) == 0 && i + 1 < argc - 1 ) {
+			repeats = atoi( argv[++i] );
+		} else if ( strcmp( argv[i], "-v" ) == 0 ) {
+			verbose = 1;
+		} else if ( strcmp( argv[i], "-e" ) == 0 && i + 1 < argc - 1 ) {
+			const char *list = argv[++i];
+			for ( e = 0; e < REPLAY_ENGINES; e++ ) {
+				size_t length = strlen( engines[e].name );
+				const char *found = strstr( list, engines[e].name );
+				engines[e].enabled = found != NULL && (found == list || found[-1] == ',') && (found[length] == ',' || found[length] == '\0');
+			}
+		} else {
+			break;
+		}
+	}
+	if ( i != argc - 1 || repeats <= 0 ) {
+		fprintf( stderr, "Usage: %s [-e astar,dijkstra,ida,sma] [-r repeats] [-v] queries.rec\n", argv[0] );
+		return 1;
+	}
+	data = read_file( argv[argc-1], &size );
+	if ( data == NULL || size < 8 || read_u32( data ) != ISLA_REPLAY_MAGIC || read_u32( data + 4 ) != ISLA_REPLAY_VERSION ) {
+		fprintf( stderr, "Cannot read recording %s\n", argv[argc-1] );
+		return 1;
+	}
+
+	while ( pos < size ) {
+		unsigned char tag = data[pos];
+		if ( tag == 'Q' && pos + 9 <= size ) {
+			start = read_u32( data + pos + 1 );
+			replay_reset( &replay );
+			replay.finish = read_u32( data + pos + 5 );
+			if ( !replay_reserve( &replay, start > replay.finish ? start : replay.finish )) {
+				fprintf( stderr, "Out of memory\n" );
+				return 1;
+			}
+			pos += 9;
+		} else if ( tag == 'N' && pos + 9 <= size ) {
+			unsigned id = read_u32( data + pos + 1 );
+			unsigned count = read_u32( data + pos + 5 );
+			unsigned k;
+			if ( pos + 9 + (size_t) count * 12 > size ) {
+				break;
+			}
+			// All ids are reserved before the node gets its degree, so it never has missing edges
+			for ( k = 0; k < count; k++ ) {
+				if ( !replay_reserve( &replay, read_u32( data + pos + 9 + k * 12 ))) {
+					fprintf( stderr, "Out of memory\n" );
+					return 1;
+				}
+			}
+			if ( !replay_reserve( &replay, id )) {
+				fprintf( stderr, "Out of memory\n" );
+				return 1;
+			}
+			while ( replay.edges + count > replay.edges_allocated ) {
+				replay.edges_allocated = replay.edges_allocated ? replay.edges_allocated * 2 : 1 << 12;
+				replay.edge_nodes = realloc( replay.edge_nodes, replay.edges_allocated * sizeof( *replay.edge_nodes ));
+				replay.edge_costs = realloc( replay.edge_costs, replay.edges_allocated * sizeof( *replay.edge_costs ));
+				if ( replay.edge_nodes == NULL || replay.edge_costs == NULL ) {
+					fprintf( stderr, "Out of memory\n" );
+					return 1;
+				}
+			}
+			replay.first[id] = (long) replay.edges;
+			replay.degree[id] = count;
+			for ( k = 0; k < count; k++ ) {
+				replay.edge_nodes[replay.edges] = read_u32( data + pos + 9 + k * 12 );
+				replay.edge_costs[replay.edges] = read_cost( data + pos + 13 + k * 12 );
+				replay.edges++;
+			}
+			pos += 9 + (size_t) count * 12;
+		} else if ( tag == 'H' && pos + 17 <= size ) {
+			unsigned id = read_u32( data + pos + 1 );
+			if ( read_u32( data + pos + 5 ) == replay.finish ) {
+				if ( !replay_reserve( &replay, id )) {
+					fprintf( stderr, "Out of memory\n" );
+					return 1;
+				}
+				replay.estimates[id] = read_cost( data + pos + 9 );
+			}
+			pos += 17;
+		} else if ( tag == 'F' && pos + 5 <= size ) {
+			unsigned id = read_u32( data + pos + 1 );
+			if ( !replay_reserve( &replay, id )) {
+				fprintf( stderr, "Out of memory\n" );
+				return 1;
+			}
+			replay.finishes[id] = 1;
+			pos += 5;
+		} else if ( tag == 'E' && pos + 9 <= size ) {
+			int status = (int) read_u32( data + pos + 1 );
+			size_t length = read_u32( data + pos + 5 );
+			size_t k;
+			if ( pos + 9 + length * 4 > size ) {
+				break;
+			}
+			if ( length > recorded_allocated ) {
+				recorded_allocated = length;
+				recorded = realloc( recorded, recorded_allocated * sizeof( *recorded ));
+				if ( recorded == NULL ) {
+					fprintf( stderr, "Out of memory\n" );
+					return 1;
+				}
+			}
+			// Nodes may move while the table grows, so pointers are taken after all ids are known
+			for ( k = 0; k < length; k++ ) {
+				if ( !replay_reserve( &replay, read_u32( data + pos + 9 + k * 4 ))) {
+					fprintf( stderr, "Out of memory\n" );
+					return 1;
+				}
+			}
+			for ( k = 0; k < length; k++ ) {
+				recorded[k] = replay.nodes + read_u32( data + pos + 9 + k * 4 );
+			}
+			pos += 9 + length * 4;
+			replay_query( &replay, start, status, recorded, length, repeats, verbose, queries++ );
+		} else {
+			break;
+		}
+	}
+	if ( pos < size ) {
+		fprintf( stderr, "Truncated or corrupted recording at byte %lu\n", (unsigned long) pos );
+	}
+
+	printf( "%lu queries\n", (unsigned long) queries );
+	for ( e = 0; e < REPLAY_ENGINES; e++ ) {
+		if ( engines[e].enabled ) {
+			printf( "%-9s %10.3f ms status mismatches %lu cost mismatches %lu path mismatches %lu misses %lu\n", engines[e].name, 1e3 * engines[e].seconds / repeats,
+				(unsigned long) engines[e].status_mismatches, (unsigned long) engines[e].cost_mismatches, (unsigned long) engines[e].path_mismatches, (unsigned long) engines[e].misses );
+		}
+	}
+	free( data );
+	free( recorded );
+	free( replay.nodes );
+	free( replay.first );
+	free( replay.degree );
+	free( replay.estimates );
+	free( replay.finishes );
+	free( replay.edge_nodes );
+	free( replay.edge_costs );
+	return 0;
+}
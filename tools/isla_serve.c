@@ -0,0 +1,404 @@
+/*
+ isla_serve - pathfinding sidecar and benchmark harness for isl_astar.h
+
+ Loads ASCII grid map once ('#' and 'T' are blocked, everything else is passable), then
+ answers (start, goal) queries from stdin or Unix socket. Queries are read in batches, each
+ batch is solved by worker threads while the next one is being read. Throughput is reported
+ to stderr at exit.
+
+ Build: cc -O2 -o isla_serve tools/isla_serve.c -lm -lpthread
+
+ Usage: isla_serve [-t threads] [-n batch] [-b] [-s socket_path] map.txt
+
+ Text queries are lines "x0 y0 x1 y1", answers are lines "status cost length" in the same
+ order. With -b queries are 4 native int32 values and answers are int32 status, int32 length
+ and double cost. With -s the server accepts connections on Unix socket one after another,
+ each connection is served like stdin.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#define ISL_ASTAR_IMPLEMENTATION
+#include "../isl_astar.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define SERVE_MAX_THREADS 64
+
+#ifndef M_SQRT2
+	#define M_SQRT2 1.41421356237309504880
+#endif
+
+typedef struct {
+	int width;
+	int height;
+	unsigned char *blocked;
+} Map;
+
+typedef struct {
+	int x0, y0, x1, y1;
+	isla_status status;
+	isla_cost cost;
+	size_t length;
+} Query;
+
+typedef struct {
+	Map *map;
+	isla_node *nodes;
+	isla_workspace workspace;
+	isla_properties properties;
+	pthread_t thread;
+	int id;
+} Worker;
+
+typedef struct {
+	Worker workers[SERVE_MAX_THREADS];
+	int nworkers;
+	Query *batch;
+	size_t count;
+	unsigned generation;
+	int running;
+	int finished;
+	pthread_mutex_t mutex;
+	pthread_cond_t start;
+	pthread_cond_t done;
+} Server;
+
+static Server server;
+
+static int map_free( Map *map, int x, int y ) {
+	return x >= 0 && y >= 0 && x < map->width && y < map->height && !map->blocked[y*map->width + x];
+}
+
+// 8-connected neighbors without corner cutting
+static isla_node *grid_neighbor( isla_node *node, isla_node *prev, void *userdata ) {
+	static const int dx[8] = {1, 0, -1, 0, 1, -1, -1, 1};
+	static const int dy[8] = {0, 1, 0, -1, 1, 1, -1, -1};
+	Worker *worker = userdata;
+	Map *map = worker->map;
+	int index = (int) (node - worker->nodes);
+	int x = index % map->width;
+	int y = index / map->width;
+	int dir = 0;
+	if ( prev != NULL ) {
+		int pindex = (int) (prev - worker->nodes);
+		int px = pindex % map->width - x;
+		int py = pindex / map->width - y;
+		while ( dx[dir] != px || dy[dir] != py ) {
+			dir++;
+		}
+		dir++;
+	}
+	for ( ; dir < 8; dir++ ) {
+		int nx = x + dx[dir];
+		int ny = y + dy[dir];
+		if ( map_free( map, nx, ny ) && (dir < 4 || (map_free( map, nx, y ) && map_free( map, x, ny )))) {
+			return worker->nodes + ny*map->width + nx;
+		}
+	}
+	return NULL;
+}
+
+static isla_cost octile_cost( isla_node *node1, isla_node *node2, void *userdata ) {
+	Worker *worker = userdata;
+	int width = worker->map->width;
+	int index1 = (int) (node1 - worker->nodes);
+	int index2 = (int) (node2 - worker->nodes);
+	int dx = abs( index1 % width - index2 % width );
+	int dy = abs( index1 / width - index2 / width );
+	return dx < dy ? dx * (M_SQRT2 - 1) + dy : dy * (M_SQRT2 - 1) + dx;
+}
+
+static int map_load( Map *map, const char *filename ) {
+	FILE *f = fopen( filename, "r" );
+	char *line = NULL;
+	size_t cap = 0;
+	ssize_t len;
+	size_t allocated = 0;
+	if ( f == NULL ) {
+		return 0;
+	}
+	map->width = 0;
+	map->height = 0;
+	map->blocked = NULL;
+	while ( (len = getline( &line, &cap, f )) > 0 ) {
+		int x;
+		while ( len > 0 && (line[len-1] == '\n' || line[len-1] == '\r') ) {
+			line[--len] = '\0';
+		}
+		if ( map->height == 0 ) {
+			map->width = (int) len;
+		}
+		if ( len != map->width || len == 0 ) {
+			break;
+		}
+		if ( (size_t) (map->height + 1) * map->width > allocated ) {
+			unsigned char *blocked;
+			allocated = allocated == 0 ? (size_t) map->width * 64 : allocated * 2;
+			blocked = realloc( map->blocked, allocated );
+			if ( blocked == NULL ) {
+				fprintf( stderr, "Out of memory\n" );
+				free( map->blocked );
+				map->blocked = NULL;
+				map->height = 0;
+				break;
+			}
+			map->blocked = blocked;
+		}
+		for ( x = 0; x < map->width; x++ ) {
+			map->blocked[map->height*map->width + x] = line[x] == '#' || line[x] == 'T';
+		}
+		map->height++;
+	}
+	free( line );
+	fclose( f );
+	return map->height > 0;
+}
+
+static void solve( Worker *worker, Query *query ) {
+	Map *map = worker->map;
+	isla_result result;
+	query->cost = 0;
+	query->length = 0;
+	if ( !map_free( map, query->x0, query->y0 ) || !map_free( map, query->x1, query->y1 )) {
+		query->status = ISLA_ERROR_BAD_ARGUMENTS;
+		return;
+	}
+	result = isla_find_path( worker->nodes + query->y0*map->width + query->x0,
+		worker->nodes + query->y1*map->width + query->x1,
+		&worker->properties, worker );
+	query->status = result.status;
+	if ( result.status == ISLA_OK ) {
+		size_t i;
+		for ( i = 1; i < result.path->length; i++ ) {
+			query->cost += octile_cost( result.path->nodes[i-1], result.path->nodes[i], worker );
+		}
+		query->length = result.path->length;
+	}
+	isla_destroy_path( result.path );
+}
+
+static void *worker_loop( void *arg ) {
+	Worker *worker = arg;
+	unsigned generation = 0;
+	for (;;) {
+		size_t i;
+		pthread_mutex_lock( &server.mutex );
+		while ( server.generation == generation && server.running ) {
+			pthread_cond_wait( &server.start, &server.mutex );
+		}
+		if ( !server.running ) {
+			pthread_mutex_unlock( &server.mutex );
+			return NULL;
+		}
+		generation = server.generation;
+		pthread_mutex_unlock( &server.mutex );
+
+		for ( i = worker->id; i < server.count; i += server.nworkers ) {
+			solve( worker, server.batch + i );
+		}
+
+		pthread_mutex_lock( &server.mutex );
+		if ( ++server.finished == server.nworkers ) {
+			pthread_cond_signal( &server.done );
+		}
+		pthread_mutex_unlock( &server.mutex );
+	}
+}
+
+static void batch_start( Query *batch, size_t count ) {
+	pthread_mutex_lock( &server.mutex );
+	server.batch = batch;
+	server.count = count;
+	server.finished = 0;
+	server.generation++;
+	pthread_cond_broadcast( &server.start );
+	pthread_mutex_unlock( &server.mutex );
+}
+
+static void batch_wait( void ) {
+	pthread_mutex_lock( &server.mutex );
+	while ( server.finished < server.nworkers ) {
+		pthread_cond_wait( &server.done, &server.mutex );
+	}
+	pthread_mutex_unlock( &server.mutex );
+}
+
+static size_t batch_read( FILE *in, Query *batch, size_t capacity, int binary ) {
+	size_t count = 0;
+	while ( count < capacity ) {
+		Query *query = batch + count;
+		if ( binary ) {
+			int values[4];
+			if ( fread( values, sizeof( values ), 1, in ) != 1 ) {
+				break;
+			}
+			query->x0 = values[0];
+			query->y0 = values[1];
+			query->x1 = values[2];
+			query->y1 = values[3];
+		} else if ( fscanf( in, "%d %d %d %d", &query->x0, &query->y0, &query->x1, &query->y1 ) != 4 ) {
+			break;
+		}
+		count++;
+	}
+	return count;
+}
+
+static void batch_write( FILE *out, Query *batch, size_t count, int binary ) {
+	size_t i;
+	for ( i = 0; i < count; i++ ) {
+		if ( binary ) {
+			int values[2];
+			double cost = batch[i].cost;
+			values[0] = batch[i].status;
+			values[1] = (int) batch[i].length;
+			fwrite( values, sizeof( values ), 1, out );
+			fwrite( &cost, sizeof( cost ), 1, out );
+		} else {
+			fprintf( out, "%s %.6f %zu\n", isla_strstatus( batch[i].status ), (double) batch[i].cost, batch[i].length );
+		}
+	}
+	fflush( out );
+}
+
+// Reads batch k+1 while workers solve batch k
+static size_t serve_stream( FILE *in, FILE *out, Query *batches[2], size_t capacity, int binary ) {
+	size_t total = 0;
+	size_t count = batch_read( in, batches[0], capacity, binary );
+	int current = 0;
+	while ( count > 0 ) {
+		size_t next;
+		batch_start( batches[current], count );
+		next = batch_read( in, batches[1-current], capacity, binary );
+		batch_wait();
+		batch_write( out, batches[current], count, binary );
+		total += count;
+		count = next;
+		current = 1 - current;
+	}
+	return total;
+}
+
+static double now( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main( int argc, char **argv ) {
+	Map map;
+	Query *batches[2];
+	size_t capacity = 256;
+	size_t total = 0;
+	const char *socket_path = NULL;
+	int binary = 0;
+	int opt;
+	int i;
+	double started;
+
+	server.nworkers = 4;
+	while ( (opt = getopt( argc, argv, "t:n:bs:" )) != -1 ) {
+		switch ( opt ) {
+			case 't': server.nworkers = atoi( optarg ); break;
+			case 'n': capacity = (size_t) atol( optarg ); break;
+			case 'b': binary = 1; break;
+			case 's': socket_path = optarg; break;
+			default:
+				fprintf( stderr, "Usage: %s [-t threads] [-n batch] [-b] [-s socket_path] map.txt\n", argv[0] );
+				return 1;
+		}
+	}
+	if ( optind >= argc || server.nworkers < 1 || server.nworkers > SERVE_MAX_THREADS || capacity == 0 || capacity > (size_t) -1 / sizeof( Query )) {
+		fprintf( stderr, "Usage: %s [-t threads] [-n batch] [-b] [-s socket_path] map.txt\n", argv[0] );
+		return 1;
+	}
+	if ( !map_load( &map, argv[optind] )) {
+		fprintf( stderr, "Can't load map %s\n", argv[optind] );
+		return 1;
+	}
+
+	batches[0] = malloc( capacity * sizeof( Query ));
+	batches[1] = malloc( capacity * sizeof( Query ));
+	if ( batches[0] == NULL || batches[1] == NULL ) {
+		fprintf( stderr, "Out of memory for batches of %zu queries\n", capacity );
+		return 1;
+	}
+	pthread_mutex_init( &server.mutex, NULL );
+	pthread_cond_init( &server.start, NULL );
+	pthread_cond_init( &server.done, NULL );
+	server.running = 1;
+
+	// Nodes hold search state, so every worker has its own copy of them
+	for ( i = 0; i < server.nworkers; i++ ) {
+		Worker *worker = server.workers + i;
+		worker->map = &map;
+		worker->id = i;
+		worker->nodes = calloc( (size_t) map.width * map.height, sizeof( isla_node ));
+		if ( worker->nodes == NULL || isla_workspace_init( &worker->workspace, 1024, 64 ) != ISLA_OK ) {
+			fprintf( stderr, "Out of memory for worker %d\n", i );
+			return 1;
+		}
+		memset( &worker->properties, 0, sizeof( worker->properties ));
+		worker->properties.next_neighbor = grid_neighbor;
+		worker->properties.eval_cost = octile_cost;
+		worker->properties.estimate_cost = octile_cost;
+		worker->properties.workspace = &worker->workspace;
+		pthread_create( &worker->thread, NULL, worker_loop, worker );
+	}
+
+	started = now();
+	if ( socket_path == NULL ) {
+		total = serve_stream( stdin, stdout, batches, capacity, binary );
+	} else {
+		struct sockaddr_un address;
+		int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+		memset( &address, 0, sizeof( address ));
+		address.sun_family = AF_UNIX;
+		strncpy( address.sun_path, socket_path, sizeof( address.sun_path ) - 1 );
+		unlink( socket_path );
+		if ( fd < 0 || bind( fd, (struct sockaddr *) &address, sizeof( address )) != 0 || listen( fd, 16 ) != 0 ) {
+			perror( "socket" );
+			return 1;
+		}
+		for (;;) {
+			int client = accept( fd, NULL, NULL );
+			FILE *in;
+			FILE *out;
+			if ( client < 0 ) {
+				break;
+			}
+			in = fdopen( client, "r" );
+			out = fdopen( dup( client ), "w" );
+			total += serve_stream( in, out, batches, capacity, binary );
+			fclose( in );
+			fclose( out );
+			fprintf( stderr, "%zu queries, %.0f queries/s\n", total, total / (now() - started));
+		}
+		close( fd );
+	}
+
+	fprintf( stderr, "%zu queries in %.3f s, %.0f queries/s, %d threads, batch %zu\n",
+		total, now() - started, total / (now() - started), server.nworkers, capacity );
+
+	pthread_mutex_lock( &server.mutex );
+	server.running = 0;
+	pthread_cond_broadcast( &server.start );
+	pthread_mutex_unlock( &server.mutex );
+	for ( i = 0; i < server.nworkers; i++ ) {
+		pthread_join( server.workers[i].thread, NULL );
+		isla_workspace_destroy( &server.workers[i].workspace );
+		free( server.workers[i].nodes );
+	}
+	free( batches[0] );
+	free( batches[1] );
+	free( map.blocked );
+	return 0;
+}
@@ -0,0 +1,206 @@
+/*
+ isla_trace2ppm - renders search trace written by isla_tracer to PPM heatmap
+
+ Every cell is colored by the number of its expansions on logarithmic scale from dark red
+ to white, cells which were generated but never expanded are dark blue, blocked cells of
+ the optional map are gray. Hot spots far from the optimal path show where heuristic is weak.
+
+ Build: cc -O2 -o isla_trace2ppm tools/isla_trace2ppm.c -lm
+
+ Usage: isla_trace2ppm [-q query] [-s scale] [-m map.txt] trace.bin out.ppm
+
+ With -q only the events between query-th and the next marks are rendered (queries are
+ numbered from zero, events before the first mark are query -1). Map is ASCII grid like
+ for isla_serve, '#' and 'T' are blocked. Scale is the size of a cell in pixels.
+*/
+
+#define ISLA_TRACE
+#include "../isl_astar.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define TRACE_ALL_QUERIES -2
+
+typedef struct {
+	unsigned stride;
+	unsigned width;
+	unsigned height;
+	unsigned *expanded;
+	unsigned char *generated;
+	unsigned max_expanded;
+	size_t events;
+} Trace;
+
+static unsigned read_u32( const unsigned char *buffer ) {
+	return (unsigned) buffer[0] | (unsigned) buffer[1] << 8 | (unsigned) buffer[2] << 16 | (unsigned) buffer[3] << 24;
+}
+
+static int trace_load( Trace *trace, const char *filename, long query ) {
+	FILE *f = fopen( filename, "rb" );
+	unsigned char record[4];
+	unsigned char header[20];
+	long current = -1;
+	if ( f == NULL ) {
+		return 0;
+	}
+	if ( fread( header, 1, sizeof( header ), f ) != sizeof( header ) || read_u32( header ) != ISLA_TRACE_MAGIC || read_u32( header + 4 ) != ISLA_TRACE_VERSION ) {
+		fclose( f );
+		return 0;
+	}
+	trace->stride = read_u32( header + 8 );
+	trace->width = read_u32( header + 12 );
+	trace->height = read_u32( header + 16 );
+	trace->expanded = calloc( (size_t) trace->width * trace->height, sizeof( *trace->expanded ));
+	trace->generated = calloc( (size_t) trace->width * trace->height, 1 );
+	trace->max_expanded = 0;
+	trace->events = 0;
+	if ( trace->expanded == NULL || trace->generated == NULL ) {
+		fclose( f );
+		return 0;
+	}
+	while ( fread( record, 1, sizeof( record ), f ) == sizeof( record )) {
+		unsigned value = read_u32( record );
+		unsigned event = value & 3;
+		unsigned index = value >> 2;
+		unsigned x = index % trace->stride;
+		unsigned y = index / trace->stride;
+		size_t cell = (size_t) y * trace->width + x;
+		if ( event == ISLA_TRACE_MARK ) {
+			current++;
+			continue;
+		}
+		if ( (query != TRACE_ALL_QUERIES && current != query) || x >= trace->width || y >= trace->height ) {
+			continue;
+		}
+		trace->events++;
+		if ( event == ISLA_TRACE_EXPAND ) {
+			if ( ++trace->expanded[cell] > trace->max_expanded ) {
+				trace->max_expanded = trace->expanded[cell];
+			}
+		} else {
+			trace->generated[cell] = 1;
+		}
+	}
+	fclose( f );
+	return 1;
+}
+
+static unsigned char *map_load( const char *filename, unsigned width, unsigned height ) {
+	FILE *f = fopen( filename, "r" );
+	unsigned char *blocked = calloc( (size_t) width * height, 1 );
+	int c;
+	unsigned x = 0;
+	unsigned y = 0;
+	if ( f == NULL || blocked == NULL ) {
+		if ( f != NULL ) {
+			fclose( f );
+		}
+		free( blocked );
+		return NULL;
+	}
+	while ( (c = fgetc( f )) != EOF && y < height ) {
+		if ( c == '\n' ) {
+			x = 0;
+			y++;
+		} else if ( c != '\r' ) {
+			if ( x < width ) {
+				blocked[(size_t) y * width + x] = c == '#' || c == 'T';
+			}
+			x++;
+		}
+	}
+	fclose( f );
+	return blocked;
+}
+
+// Black body palette: dark red, red, yellow, white
+static void heat_color( double t, unsigned char *rgb ) {
+	double r = 0.25 + t * 2.25;
+	double g = t * 3 - 1;
+	double b = t * 3 - 2;
+	rgb[0] = (unsigned char) (255 * (r > 1 ? 1 : r));
+	rgb[1] = (unsigned char) (255 * (g < 0 ? 0 : g > 1 ? 1 : g));
+	rgb[2] = (unsigned char) (255 * (b < 0 ? 0 : b > 1 ? 1 : b));
+}
+
+static int ppm_write( const char *filename, const Trace *trace, const unsigned char *blocked, unsigned scale ) {
+	FILE *f = fopen( filename, "wb" );
+	unsigned char *row = malloc( (size_t) trace->width * scale * 3 );
+	double top = log( 1.0 + trace->max_expanded );
+	unsigned x, y, i;
+	int ok = 1;
+	if ( f == NULL || row == NULL ) {
+		if ( f != NULL ) {
+			fclose( f );
+		}
+		free( row );
+		return 0;
+	}
+	fprintf( f, "P6\n%u %u\n255\n", trace->width * scale, trace->height * scale );
+	for ( y = 0; y < trace->height; y++ ) {
+		for ( x = 0; x < trace->width; x++ ) {
+			size_t cell = (size_t) y * trace->width + x;
+			unsigned char rgb[3] = {0, 0, 0};
+			if ( trace->expanded[cell] > 0 ) {
+				heat_color( top > 0 ? log( 1.0 + trace->expanded[cell] ) / top : 1, rgb );
+			} else if ( trace->generated[cell] ) {
+				rgb[2] = 96;
+			} else if ( blocked != NULL && blocked[cell] ) {
+				rgb[0] = rgb[1] = rgb[2] = 128;
+			}
+			for ( i = 0; i < scale; i++ ) {
+				memcpy( row + ((size_t) x * scale + i) * 3, rgb, 3 );
+			}
+		}
+		for ( i = 0; i < scale && ok; i++ ) {
+			ok = fwrite( row, 3, (size_t) trace->width * scale, f ) == (size_t) trace->width * scale;
+		}
+	}
+	free( row );
+	return fclose( f ) == 0 && ok;
+}
+
+int main( int argc, char **argv ) {
+	Trace trace;
+	unsigned char *blocked = NULL;
+	const char *mapname = NULL;
+	long query = TRACE_ALL_QUERIES;
+	unsigned scale = 1;
+	int i;
+
+	for ( i = 1; i < argc - 2; i++ ) {
+		if ( strcmp( argv[i], "-q" ) == 0 && i + 1 < argc - 2 ) {
+			query = atol( argv[++i] );
+		} else if ( strcmp( argv[i], "-s" ) == 0 && i + 1 < argc - 2 ) {
+			scale = (unsigned) atoi( argv[++i] );
+		} else if ( strcmp( argv[i], "-m" ) == 0 && i + 1 < argc - 2 ) {
+			mapname = argv[++i];
+		} else {
+			break;
+		}
+	}
+	if ( i != argc - 2 || scale == 0 ) {
+		fprintf( stderr, "Usage: %s [-q query] [-s scale] [-m map.txt] trace.bin out.ppm\n", argv[0] );
+		return 1;
+	}
+	if ( !trace_load( &trace, argv[argc-2], query )) {
+		fprintf( stderr, "Cannot read trace %s\n", argv[argc-2] );
+		return 1;
+	}
+	if ( mapname != NULL && (blocked = map_load( mapname, trace.width, trace.height )) == NULL ) {
+		fprintf( stderr, "Cannot read map %s\n", mapname );
+		return 1;
+	}
+	if ( !ppm_write( argv[argc-1], &trace, blocked, scale )) {
+		fprintf( stderr, "Cannot write %s\n", argv[argc-1] );
+		return 1;
+	}
+	fprintf( stderr, "%zu events, %u max expansions of a cell\n", trace.events, trace.max_expanded );
+	free( trace.expanded );
+	free( trace.generated );
+	free( blocked );
+	return 0;
+}